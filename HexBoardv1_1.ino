@@ -48,7 +48,7 @@ byte Hardware_Version = HARDWARE_UNKNOWN; // Software-detected hardware revision
 //  Everything else runs on the first core.
 
 //  a global variable used to control the timing of setup functions between cores
-int setup_phase = 0;
+volatile int setup_phase = 0;
 
 void setup() {
   #if (defined(ARDUINO_ARCH_MBED) && defined(ARDUINO_ARCH_RP2040))
@@ -66,12 +66,17 @@ void setup() {
   OLED_setup();               //  Start the OLED screen, in case you want a splash screen?
   presets_littleFS_setup();   //  Set up the littleFS file system first (to pull stored user settings in v2) 
   hardware_setup();           //  set up the keyboard, rotary, and audio functions based on config constants.
-    setup_phase = 1;        //  change the setup flag to let the other core know to start the background processes
-  synth_reset();              //  make sure the synth is reset so no notes are running
+  if (keys_are_analog) {
+    presets_load_key_calibration();   //  before the scanner starts on the other core
+  }
+  synth_setup();              //  build the wavetables, and make sure the synth is reset so no notes are running
+  setup_phase = 1;            //  change the setup flag to let the other core know to start the background processes
   MIDI_setup();               //  Set up the USB (Serial, pin 0) and MIDI-out (Serial1, pin 1) as MIDI objects
   gridSystem_setup();         //  Set up the hex grid object, and set the pins that will read the button states
   applyLayout(); // see V1.assignment.h. Based on the default layout, populate grid with notes and colors
   LED_setup();                //  Once the grid is defined, start the LEDs
+  while (setup_phase < 2) {}  //  wait for the other core to measure what the synth costs
+  synth_set_polyphony();      //  then fit the synth voices to the time there is
   menu_setup();               //  Set up the menu last.
 
 }
@@ -79,8 +84,9 @@ void loop() { // need to add soft loop timing.
   timing_measure_lap();         //  get time in uS at the start of the loop, measure loop duration
   OLED_screenSaver();           //  every 1 second. reduces wear-and-tear on OLED panel  
   interface_interpret_hexes();  //  every loop. interpret button press actions, play MIDI / synth notes
+  interface_update_pressure();  //  every loop. analog keys only, send channel pressure of held notes
   interface_update_wheels();    //  v1.0 firmware only. deal with the pitch/mod wheel
-  synth_arpeggiate();           //  every X millis based on user input. arpeggiate if synth mode allows it
+  synth_reclaim_voices();       //  every loop. free the synth voices that have finished their release
   animate_calculate_pixels();   //  every 17 or 33 millis, calculate the next frame of responsive animations
   LED_update_pixels();          //  every 17 or 33 millis, send updated pixel data to LEDs
   interface_interpret_rotary(); //  every loop. interpret rotary knob presses, send to menu object, refresh OLED
@@ -88,12 +94,19 @@ void loop() { // need to add soft loop timing.
 
 void setup1() {
   while (setup_phase < 1) {}    //  wait until the hardware objects have been set up in the other core
+  synth_measure_costs();        //  time the synth on the core it runs on, before the audio starts
+  setup_phase = 2;
   hardware_start_background_process();   //  begin the background loops on this core
 }
 void loop1() {
   //  dedicate this core to computing the synth audio and running the background processes.
-  if (audioOut.roomToWrite()) {
-    audioOut.write(synth.next_sample());   //  write synth samples tnto the audio buffer.
+  uint room = audioOut.roomToWrite();
+  if (room) {
+    audio_sample block[SYNTH_BLOCK_SIZE];
+    uint n = std::min(room, (uint)SYNTH_BLOCK_SIZE);
+    synth.render(block, n);                //  render a block of synth samples
+    effects.process(block, n);             //  add delay / chorus, if they are on
+    audioOut.write_block(block, n);        //  and write them into the audio buffer.
   }
   //  and respond to all hardware task manager interrupts when they are called.
 }
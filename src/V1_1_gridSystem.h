@@ -28,9 +28,9 @@ struct button_t : switch_t {
   uint pixel; // associated pixel
   uint index; // location within its array
   std::map<time_uS, uint> state_history;
-  time_uS timePressed;
-  int btnState;
-  int prevState;
+  time_uS timePressed = 0;   // when the scanner saw the press, 0 if not pressed
+  int btnState = 0;
+  int prevState = 0;
   uint8_t zero = 0;
   pixel_code LEDcodeAnim = 0;     // calculate it once and store value, to make LED playback snappier 
   pixel_code LEDcodePlay = 0;     // calculate it once and store value, to make LED playback snappier
@@ -52,6 +52,8 @@ struct music_key_t : button_t {
   uint8_t  MIDIch = 0;          // what MIDI channel this note is playing on
   uint8_t  synthCh = 0;         // what synth polyphony ch this is playing on
   float    frequency = 0.0;     // what frequency to ring on the synther
+  uint8_t  velocity = 0;        // note-on velocity, from the analog key or the velocity wheel
+  uint8_t  pressure = 0;        // last channel pressure sent, analog keys only
   music_key_t(button_t btn) : button_t(btn.hwKey, btn.type, btn.coord, btn.pixel) {}
 };
 
@@ -78,6 +80,9 @@ struct switchboard_t {
   std::map<hex_t, int>   coord_to_pixel; // e.g. hex(0,-6) -> pixel 5
   std::map<int, bool>    pixel_is_cmd;  // e.g. pixel 5 -> false, pixel 80 -> true
   std::map<int, uint>    pixel_to_index; // e.g. pixel 5 -> 4 (key), pixel 80 -> 4 (cmd)
+  //  direct lookup from the scanner's bit number, N_A if not that kind of button
+  std::vector<int>       hwKey_to_key;   // e.g. hwKey 17 -> 4 (index in keys)
+  std::vector<int>       hwKey_to_cmd;   // e.g. hwKey 12 -> 2 (index in commands)
   music_key_t& key_at_pixel(const int pxl) {
     return keys[pixel_to_index.at(pxl)];
   }
@@ -204,6 +209,8 @@ switchboard_t hexBoard;
 const byte_vec assignCmd = {0,20,40,60,80,100,120};
 
 void gridSystem_setup() {
+  hexBoard.hwKey_to_key.assign(pinGrid.buttonCount(), N_A);
+  hexBoard.hwKey_to_cmd.assign(pinGrid.buttonCount(), N_A);
   for (auto& b : config_hexboard_layout) {
     switch_t tempSwitch(
       pinGrid.linear_index(b.column_pin_index,b.multiplexer_value),
@@ -231,10 +238,12 @@ void gridSystem_setup() {
           other_cmd_t tempCmd(tempButton);
           tempCmd.cmd = findCmd - assignCmd.begin();
           hexBoard.pixel_to_index[tempCmd.pixel] = hexBoard.commands.size();
+          hexBoard.hwKey_to_cmd[tempCmd.hwKey] = hexBoard.commands.size();
           hexBoard.commands.emplace_back(tempCmd);
         } else {
           music_key_t tempKey(tempButton);
           hexBoard.pixel_to_index[tempKey.pixel] = hexBoard.keys.size();
+          hexBoard.hwKey_to_key[tempKey.hwKey] = hexBoard.keys.size();
           hexBoard.keys.emplace_back(tempKey);
         }
         break;
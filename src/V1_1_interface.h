@@ -15,66 +15,99 @@ void setupHardware() {
   }
 }
 
-void interface_interpret_hexes() {
-  // only do this if the pingrid object is free
-  if (!(pinGrid.is_background_process_complete())) {
-    return;
-  }
-  // read in the new pin state completely first
-  for (auto& h : hexBoard.keys) {
-    h.prevState = h.btnState;
-    int r = pinGrid.read_key_state(h.hwKey);
-    h.btnState = (r == LOW);
-  }
-  for (auto& h : hexBoard.commands) {
-    h.prevState = h.btnState;
-    int r = pinGrid.read_key_state(h.hwKey);
-    h.btnState = (r == LOW);
+void interface_interpret_music_key(music_key_t& h) {
+  sendToLog(
+    " pxl " + std::to_string(h.pixel)
+    + " hw " + std::to_string(h.hwKey)
+    + " hex " + std::to_string(h.coord.x) + "," + std::to_string(h.coord.y)
+    + " note " + std::to_string(h.note)
+    + " scal " + std::to_string(h.inScale)
+    + " btn " + std::to_string((h.btnState << 1) | h.prevState)
+  );
+  if (h.inScale || (!scaleLock)) {
+    switch ((h.btnState << 1) | h.prevState) {
+      case 2: // just pressed
+        tryMIDInoteOn(h);
+        trySynthNoteOn(h);
+        break;
+      case 1: // just released    
+        tryMIDInoteOff(h);
+        trySynthNoteOff(h); 
+    }
   }
-  // release pingrid object
-  pinGrid.resume_background_process();
-  // then cycle each key and perform actions  
-  for (auto& h : hexBoard.keys) {
-    sendToLog(
-      " pxl " + std::to_string(h.pixel)
-      + " hw " + std::to_string(h.hwKey)
-      + " hex " + std::to_string(h.coord.x) + "," + std::to_string(h.coord.y)
-      + " note " + std::to_string(h.note)
-      + " scal " + std::to_string(h.inScale)
-      + " btn " + std::to_string((h.btnState << 1) | h.prevState)
-    );
-    if (h.inScale || (!scaleLock)) {
-      switch ((h.btnState << 1) | h.prevState) {
-        case 2: // just pressed
-          tryMIDInoteOn(h);
-          trySynthNoteOn(h);
+}
+
+void interface_interpret_command(other_cmd_t& h) {
+  sendToLog(
+    " pxl " + std::to_string(h.pixel)
+    + " hw " + std::to_string(h.hwKey)
+    + " hex " + std::to_string(h.coord.x) + "," + std::to_string(h.coord.y)
+    + " cmd " + std::to_string(h.cmd)
+    + " btn " + std::to_string((h.btnState << 1) | h.prevState)
+  );
+  switch ((h.btnState << 1) | h.prevState) {
+    case 2: // just pressed
+      switch (h.cmd) {
+        case CMDB + 3:
+          toggleWheel = !toggleWheel;
+          break;
+        default:
+          // the rest should all be taken care of within the wheelDef structure
           break;
-        case 1: // just released    
-          tryMIDInoteOff(h);
-          trySynthNoteOff(h); 
       }
+    default: // inactive
+      break;
+  }
+}
+
+void interface_interpret_hexes() {
+  // the scanner queues a timestamped event for each key that changed,
+  // so presses are handled in the order they happened and keep the
+  // time they happened, however long this loop took.
+  key_event_t e;
+  while (pinGrid.read_key_event(e)) {
+    if (e.hwKey >= hexBoard.hwKey_to_key.size()) {
+      continue;
+    }
+    // the state goes 0 -> 2 (just pressed) -> 3 (held) -> 1 (just released) -> 0,
+    // so settle the previous state once the edge has been acted on.
+    if (hexBoard.hwKey_to_key[e.hwKey] != N_A) {
+      music_key_t& h = hexBoard.keys[hexBoard.hwKey_to_key[e.hwKey]];
+      h.prevState = h.btnState;
+      h.btnState = e.pressed;
+      h.timePressed = (e.pressed ? e.timestamp : 0);
+      if (e.pressed) {
+        // analog keys measure their own velocity
+        h.velocity = (e.velocity ? e.velocity : velWheel.curValue);
+      }
+      interface_interpret_music_key(h);
+      h.prevState = h.btnState;
+    } else if (hexBoard.hwKey_to_cmd[e.hwKey] != N_A) {
+      other_cmd_t& h = hexBoard.commands[hexBoard.hwKey_to_cmd[e.hwKey]];
+      h.prevState = h.btnState;
+      h.btnState = e.pressed;
+      h.timePressed = (e.pressed ? e.timestamp : 0);
+      interface_interpret_command(h);
+      h.prevState = h.btnState;
     }
   }
-  for (auto& h : hexBoard.commands) {
-    sendToLog(
-      " pxl " + std::to_string(h.pixel)
-      + " hw " + std::to_string(h.hwKey)
-      + " hex " + std::to_string(h.coord.x) + "," + std::to_string(h.coord.y)
-      + " cmd " + std::to_string(h.cmd)
-      + " btn " + std::to_string((h.btnState << 1) | h.prevState)
-    );
-    switch ((h.btnState << 1) | h.prevState) {
-      case 2: // just pressed
-        switch (h.cmd) {
-          case CMDB + 3:
-            toggleWheel = !toggleWheel;
-            break;
-          default:
-            // the rest should all be taken care of within the wheelDef structure
-            break;
-        }
-      default: // inactive
-        break;
+}
+
+// analog keys only. the scanner keeps the latest pressure of each key,
+// so only the held notes are checked, and small changes are skipped
+// to keep the MIDI stream light.
+void interface_update_pressure() {
+  if (!pinGrid.is_analog()) {
+    return;
+  }
+  for (auto& h : hexBoard.keys) {
+    if (!(h.btnState && h.MIDIch)) {
+      continue;
+    }
+    uint8_t p = pinGrid.get_key_pressure(h.hwKey);
+    if (abs((int)p - (int)h.pressure) >= (int)analog_pressure_min_change
+      || ((p == 0) && h.pressure)) {
+      tryMIDIpressure(h, p);
     }
   }
 }
@@ -89,8 +122,7 @@ void interface_update_wheels() {
     pbWheel.setTargetValue();
     upd = pbWheel.updateValue(runTime);
     if (upd) {
-      sendMIDIpitchBendToCh1();
-      updateSynthWithNewFreqs();
+      sendMIDIpitchBendToCh1();   // the synth reads the wheel by itself
     }
   } else {
     modWheel.setTargetValue();
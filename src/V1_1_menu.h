@@ -59,6 +59,9 @@ GEMItem  menuControlBack("<< Back", menuPageMain);
 GEMPage  menuPageAdvanced("Advanced");
 GEMItem  menuGotoAdvanced("Advanced", menuPageAdvanced);
 GEMItem  menuAdvancedBack("<< Back", menuPageMain);
+GEMPage  menuPagePerformance("Performance");
+GEMItem  menuGotoPerformance("Performance", menuPagePerformance);
+GEMItem  menuPerformanceBack("<< Back", menuPageAdvanced);
 GEMPage  menuPageReboot("Ready to flash firmware!");
 /*
   We haven't written the code for some procedures,
@@ -71,6 +74,8 @@ GEMPage  menuPageReboot("Ready to flash firmware!");
 */
 void changeTranspose();
 void rebootToBootloader();
+void refreshPerformanceStats();
+void resetPerformanceStats();
 /*
   This GEMItem is meant to just be a read-only text label.
   To be honest I don't know how to get just a plain text line to show here other than this!
@@ -138,6 +143,7 @@ GEMItem menuItemMPEpitchBend( "MPE Bend Range:", MPEpitchBendSemis, selectMPEpit
 SelectOptionByte optionByteYesOrNo[] =  { { "No", 0 }, { "Yes" , 1 } };
 GEMSelect selectYesOrNo( sizeof(optionByteYesOrNo)  / sizeof(SelectOptionByte), optionByteYesOrNo);
 GEMItem  menuItemScaleLock( "Scale lock?", scaleLock, selectYesOrNo);
+GEMItem  menuItemRetrigger( "Retrigger:", synthRetrigger, selectYesOrNo);
 GEMItem  menuItemPercep( "Fix color:", perceptual, selectYesOrNo, setLEDcolorCodes);
 GEMItem  menuItemShiftColor( "ColorByKey", paletteBeginsAtKeyCenter, selectYesOrNo, setLEDcolorCodes);
 GEMItem  menuItemWheelAlt( "Alt wheel?", wheelMode, selectYesOrNo);
@@ -154,6 +160,14 @@ SelectOptionByte optionBytePlayback[] = { { "Off", SYNTH_OFF }, { "Mono", SYNTH_
 GEMSelect selectPlayback(sizeof(optionBytePlayback) / sizeof(SelectOptionByte), optionBytePlayback);
 GEMItem  menuItemPlayback(  "Synth mode:",       playbackMode,  selectPlayback, synth_reset);
 
+// poly synth voices. the count may be held back if the synth would run out of time.
+SelectOptionInt optionIntPolyphony[] = { { "4", 4 }, { "6", 6 }, { "8", 8 }, { "10", 10 }, { "12", 12 }, { "16", 16 } };
+GEMSelect selectPolyphony(sizeof(optionIntPolyphony) / sizeof(SelectOptionInt), optionIntPolyphony);
+GEMItem  menuItemPolyphony( "Voices:", synthPolyphony, selectPolyphony, synth_set_polyphony);
+SelectOptionByte optionByteSteal[] = { { "Off", STEAL_OFF }, { "Oldest", STEAL_OLDEST }, { "Quietst", STEAL_QUIETEST } };
+GEMSelect selectSteal(sizeof(optionByteSteal) / sizeof(SelectOptionByte), optionByteSteal);
+GEMItem  menuItemSteal( "Steal:", synthStealPolicy, selectSteal);
+
 // Hardware V1.2-only
 SelectOptionByte optionByteAudioD[] =  {
   { "Buzzer", AUDIO_PIEZO }, { "Jack" , AUDIO_AJACK }, { "Both", AUDIO_BOTH }, { "Off", AUDIO_NONE}
@@ -314,9 +328,53 @@ GEMSelect selectBright( sizeof(optionByteBright) / sizeof(SelectOptionByte), opt
 GEMItem menuItemBright( "Brightness", globalBrightness, selectBright, setLEDcolorCodes);
 
 SelectOptionByte optionByteWaveform[] = { { "Hybrid", WAVEFORM_HYBRID }, { "Square", WAVEFORM_SQUARE }, { "Saw", WAVEFORM_SAW },
-{"Triangl", WAVEFORM_TRIANGLE}, {"Sine", WAVEFORM_SINE}, {"Strings", WAVEFORM_STRINGS}, {"Clrinet", WAVEFORM_CLARINET} };
+{"Triangl", WAVEFORM_TRIANGLE}, {"Sine", WAVEFORM_SINE}, {"Strings", WAVEFORM_STRINGS}, {"Clrinet", WAVEFORM_CLARINET}, {"User", WAVEFORM_USER},
+{"FM", WAVEFORM_FM}, {"Pluck", WAVEFORM_PLUCK} };
 GEMSelect selectWaveform(sizeof(optionByteWaveform) / sizeof(SelectOptionByte), optionByteWaveform);
-GEMItem  menuItemWaveform( "Waveform:", currWave, selectWaveform, synth_reset);
+GEMItem  menuItemWaveform( "Waveform:", currWave, selectWaveform, synth_set_polyphony);
+SelectOptionInt optionIntFMRatio[] = { { "1", 1 }, { "2", 2 }, { "3", 3 }, { "4", 4 }, { "5", 5 }, { "6", 6 }, { "7", 7 }, { "8", 8 } };
+GEMSelect selectFMRatio(sizeof(optionIntFMRatio) / sizeof(SelectOptionInt), optionIntFMRatio);
+GEMItem  menuItemFMRatio( "FM ratio:", fmRatio, selectFMRatio);
+SelectOptionInt optionIntFMIndex[] = { { "0", 0 }, { "1", 1 }, { "2", 2 }, { "3", 3 }, { "4", 4 }, { "6", 6 }, { "8", 8 } };
+GEMSelect selectFMIndex(sizeof(optionIntFMIndex) / sizeof(SelectOptionInt), optionIntFMIndex);
+GEMItem  menuItemFMIndex( "FM index:", fmIndex, selectFMIndex);
+
+SelectOptionInt optionIntEnvTime[] = { { "0 mS", 0 }, { "5 mS", 5 }, { "20 mS", 20 }, { "50 mS", 50 },
+  { "150 mS", 150 }, { "300 mS", 300 }, { "600 mS", 600 }, { "1 sec", 1000 }, { "2 sec", 2000 }, { "4 sec", 4000 } };
+GEMSelect selectEnvTime(sizeof(optionIntEnvTime) / sizeof(SelectOptionInt), optionIntEnvTime);
+SelectOptionInt optionIntEnvLevel[] = { { "0%", 0 }, { "25%", 32 }, { "50%", 64 }, { "75%", 96 }, { "100%", 127 } };
+GEMSelect selectEnvLevel(sizeof(optionIntEnvLevel) / sizeof(SelectOptionInt), optionIntEnvLevel);
+GEMItem  menuItemEnvAttack(  "Attack:",  envAttack_mS,  selectEnvTime,  synth_set_envelope);
+GEMItem  menuItemEnvDecay(   "Decay:",   envDecay_mS,   selectEnvTime,  synth_set_envelope);
+GEMItem  menuItemEnvSustain( "Sustain:", envSustain,    selectEnvLevel, synth_set_envelope);
+GEMItem  menuItemEnvRelease( "Release:", envRelease_mS, selectEnvTime,  synth_set_envelope);
+
+SelectOptionByte optionByteArpOrder[] = { { "Up", ARP_UP }, { "Down", ARP_DOWN }, { "Up-down", ARP_UP_DOWN },
+  { "Random", ARP_RANDOM }, { "Played", ARP_AS_PLAYED } };
+GEMSelect selectArpOrder(sizeof(optionByteArpOrder) / sizeof(SelectOptionByte), optionByteArpOrder);
+GEMItem  menuItemArpOrder( "Arp order:", arpOrder, selectArpOrder);
+SelectOptionInt optionIntArpOctaves[] = { { "1", 1 }, { "2", 2 }, { "3", 3 }, { "4", 4 } };
+GEMSelect selectArpOctaves(sizeof(optionIntArpOctaves) / sizeof(SelectOptionInt), optionIntArpOctaves);
+GEMItem  menuItemArpOctaves( "Arp octaves:", arpOctaves, selectArpOctaves);
+SelectOptionInt optionIntArpStep[] = { { "33 mS", 33 }, { "50 mS", 50 }, { "66 mS", 66 }, { "100 mS", 100 },
+  { "125 mS", 125 }, { "166 mS", 166 }, { "250 mS", 250 }, { "333 mS", 333 }, { "500 mS", 500 } };
+GEMSelect selectArpStep(sizeof(optionIntArpStep) / sizeof(SelectOptionInt), optionIntArpStep);
+GEMItem  menuItemArpStep( "Arp step:", arpStep_mS, selectArpStep, synth_set_arpeggio);
+
+SelectOptionByte optionByteEffects[] = { { "Off", EFFECTS_OFF }, { "Delay", EFFECTS_DELAY }, { "Chorus", EFFECTS_CHORUS },
+  { "Both", EFFECTS_BOTH } };
+GEMSelect selectEffects(sizeof(optionByteEffects) / sizeof(SelectOptionByte), optionByteEffects);
+GEMItem  menuItemEffects( "Effects:", effectsMode, selectEffects, synth_set_effects);
+SelectOptionInt optionIntDelayTime[] = { { "60 mS", 60 }, { "90 mS", 90 }, { "125 mS", 125 }, { "180 mS", 180 },
+  { "250 mS", 250 }, { "333 mS", 333 }, { "400 mS", 400 }, { "500 mS", 500 } };
+GEMSelect selectDelayTime(sizeof(optionIntDelayTime) / sizeof(SelectOptionInt), optionIntDelayTime);
+GEMItem  menuItemDelayTime( "Delay time:", delayTime_mS, selectDelayTime, synth_set_effects);
+SelectOptionInt optionIntEffectPercent[] = { { "0%", 0 }, { "10%", 10 }, { "20%", 20 }, { "35%", 35 }, { "50%", 50 },
+  { "65%", 65 }, { "80%", 80 } };
+GEMSelect selectEffectPercent(sizeof(optionIntEffectPercent) / sizeof(SelectOptionInt), optionIntEffectPercent);
+GEMItem  menuItemDelayFeedback( "Feedback:", delayFeedback, selectEffectPercent, synth_set_effects);
+GEMItem  menuItemDelayMix( "Delay mix:", delayMix, selectEffectPercent, synth_set_effects);
+GEMItem  menuItemChorusMix( "Chorus mix:", chorusMix, selectEffectPercent, synth_set_effects);
 
 SelectOptionInt optionIntModWheel[] = { { "too slo", 1 }, { "Turtle", 2 }, { "Slow", 4 }, 
   { "Medium",    8 }, { "Fast",     16 }, { "Cheetah",  32 }, { "Instant", 127 } };
@@ -329,6 +387,71 @@ SelectOptionInt optionIntPBWheel[] =  { { "too slo", 128 }, { "Turtle", 256 }, {
 GEMSelect selectPBSpeed(sizeof(optionIntPBWheel) / sizeof(SelectOptionInt), optionIntPBWheel);
 GEMItem  menuItemPBSpeed( "PB wheel:", pbWheelSpeed, selectPBSpeed);
 
+/*
+  The performance page shows how much of core 1 each
+  background task uses and how late it starts, as
+  measured by the task manager (see hardware.h).
+  GEM reads values by reference, so the statistics are
+  copied into this table whenever "Refresh" is selected.
+  The items themselves are built in createPerformanceMenuItems().
+*/
+enum {
+  perf_exec_min, perf_exec_avg, perf_exec_max,
+  perf_jitter_avg, perf_jitter_max, perf_missed, perf_load,
+  perf_stat_count
+};
+const uint perfTaskCount = 3; // see the task IDs in hardware.h
+const char* perfTaskNames[perfTaskCount] = { "Audio", "Rotary", "Keys" };
+const char* perfStatNames[perf_stat_count] = { "min uS", "avg uS", "max uS", "avg late", "max late", "missed", "load .1%" };
+str  perfLabels[perfTaskCount][perf_stat_count];
+int  perfStats[perfTaskCount][perf_stat_count];
+GEMItem* menuItemPerf[perfTaskCount][perf_stat_count];
+int  perfLateTicks = 0;
+int  perfUnderruns = 0;
+int  perfOverruns = 0;
+int  perfKeyQueueFull = 0;
+int  perfChatterTotal = 0;
+int  perfChatterPixel = N_A;    // the key that bounced most
+int  perfChatterWorst = 0;
+int  perfSynthDropped = 0;
+int  perfSynthStolen = 0;
+int  perfEffectsCycles = 0;
+int  perfEffectsBypassed = 0;
+GEMItem  menuItemPerfLate("Late ticks", perfLateTicks, GEM_READONLY);
+GEMItem  menuItemPerfUnderruns("Buf underrun", perfUnderruns, GEM_READONLY);
+GEMItem  menuItemPerfOverruns("Buf overrun", perfOverruns, GEM_READONLY);
+GEMItem  menuItemPerfKeyQueueFull("Key q full", perfKeyQueueFull, GEM_READONLY);
+GEMItem  menuItemPerfChatterTotal("Chatter all", perfChatterTotal, GEM_READONLY);
+GEMItem  menuItemPerfChatterPixel("Chatter key", perfChatterPixel, GEM_READONLY);
+GEMItem  menuItemPerfChatterWorst("Chatter max", perfChatterWorst, GEM_READONLY);
+GEMItem  menuItemPerfRefresh("Refresh", refreshPerformanceStats);
+GEMItem  menuItemPerfReset("Reset stats", resetPerformanceStats);
+GEMItem  menuItemPerfWavetables("Wavetbl bytes", wavetableBytes, GEM_READONLY);
+GEMItem  menuItemPerfSynthVoices("Synth voices", synthPolyphonyInUse, GEM_READONLY);
+GEMItem  menuItemPerfSynthDropped("Notes dropped", perfSynthDropped, GEM_READONLY);
+GEMItem  menuItemPerfSynthStolen("Voices stolen", perfSynthStolen, GEM_READONLY);
+GEMItem  menuItemPerfEffectsCycles("Effects cyc", perfEffectsCycles, GEM_READONLY);
+GEMItem  menuItemPerfEffectsBypassed("FX bypassed", perfEffectsBypassed, GEM_READONLY);
+
+/*
+  Analog key calibration. These items are only
+  shown if config.h says the keys are analog.
+  To calibrate: with no keys touched, select
+  "Key rest". Then turn "Key bottom" on, press
+  every key all the way down, and turn it off.
+  "Save key cal" keeps the result on the flash.
+*/
+uint8_t calibratingBottom = 0;
+void captureKeyRest() {
+  pinGrid.analog().capture_rest();
+}
+void captureKeyBottom() {
+  pinGrid.analog().capture_bottom(calibratingBottom);
+}
+GEMItem  menuItemKeyRest("Key rest", captureKeyRest);
+GEMItem  menuItemKeyBottom("Key bottom:", calibratingBottom, selectYesOrNo, captureKeyBottom);
+GEMItem  menuItemKeySave("Save key cal", presets_save_key_calibration);
+
 // Call this procedure to return to the main menu
 void menuHome() {
   menu.setMenuPageCurrent(menuPageMain);
@@ -513,6 +636,86 @@ void createScaleMenuItems() {
   showOnlyValidScaleChoices();
 }
 
+void refreshPerformanceStats() {
+  uint32_t now = timer_hw->timerawl;
+  const int taskIDs[perfTaskCount] = { audio_task_ID, rotary_task_ID, keyboard_task_ID };
+  for (uint T = 0; T < perfTaskCount; T++) {
+    task_stats_t stats;
+    if (taskIDs[T] != N_A) {
+      stats = task_mgr.get_stats(taskIDs[T]);
+    } else if (T == 0 && audioOut.uses_DMA()) {
+      stats = audioOut.get_DMA_stats();   // refill interrupt; misses are buffer underruns
+    } else {
+      continue;
+    }
+    perfStats[T][perf_exec_min]   = (stats.runs ? stats.exec_min : 0);
+    perfStats[T][perf_exec_avg]   = stats.exec_avg();
+    perfStats[T][perf_exec_max]   = stats.exec_max;
+    perfStats[T][perf_jitter_avg] = stats.jitter_avg();
+    perfStats[T][perf_jitter_max] = stats.jitter_max;
+    perfStats[T][perf_missed]     = stats.missed;
+    perfStats[T][perf_load]       = stats.load_permille(now);
+  }
+  perfLateTicks = task_mgr.get_late_ticks();
+  perfUnderruns = audioOut.get_underruns();
+  perfOverruns = audioOut.get_overruns();
+  perfKeyQueueFull = pinGrid.get_key_queue_full();
+  // find the switch that bounces the most, by pixel number
+  perfChatterTotal = 0;
+  perfChatterPixel = N_A;
+  perfChatterWorst = 0;
+  auto checkChatter = [](button_t& h) {
+    int c = pinGrid.get_chatter_count(h.hwKey);
+    perfChatterTotal += c;
+    if (c > perfChatterWorst) {
+      perfChatterWorst = c;
+      perfChatterPixel = h.pixel;
+    }
+  };
+  for (auto& h : hexBoard.keys)     { checkChatter(h); }
+  for (auto& h : hexBoard.commands) { checkChatter(h); }
+  perfSynthDropped = synthVoices.dropped;
+  perfSynthStolen = synthVoices.stolen;
+  perfEffectsCycles = effects.cycles >> 4;
+  perfEffectsBypassed = effects.bypassed;
+  menu.drawMenu();
+}
+void resetPerformanceStats() {
+  task_mgr.reset_stats();
+  audioOut.reset_DMA_stats();
+  audioOut.reset_buffer_counts();
+  pinGrid.reset_key_queue_full();
+  pinGrid.reset_chatter_counts();
+  synthVoices.dropped = 0;
+  synthVoices.stolen = 0;
+  effects.bypassed = 0;
+  refreshPerformanceStats();
+}
+void createPerformanceMenuItems() {
+  menuPagePerformance.addMenuItem(menuItemPerfRefresh);
+  for (uint T = 0; T < perfTaskCount; T++) {
+    for (uint S = 0; S < perf_stat_count; S++) {
+      perfLabels[T][S] = str(perfTaskNames[T]) + " " + perfStatNames[S];
+      menuItemPerf[T][S] = new GEMItem(perfLabels[T][S].c_str(), perfStats[T][S], GEM_READONLY);
+      menuPagePerformance.addMenuItem(*menuItemPerf[T][S]);
+    }
+  }
+  menuPagePerformance.addMenuItem(menuItemPerfLate);
+  menuPagePerformance.addMenuItem(menuItemPerfUnderruns);
+  menuPagePerformance.addMenuItem(menuItemPerfOverruns);
+  menuPagePerformance.addMenuItem(menuItemPerfKeyQueueFull);
+  menuPagePerformance.addMenuItem(menuItemPerfChatterTotal);
+  menuPagePerformance.addMenuItem(menuItemPerfChatterPixel);
+  menuPagePerformance.addMenuItem(menuItemPerfChatterWorst);
+  menuPagePerformance.addMenuItem(menuItemPerfReset);
+  menuPagePerformance.addMenuItem(menuItemPerfSynthVoices);
+  menuPagePerformance.addMenuItem(menuItemPerfSynthDropped);
+  menuPagePerformance.addMenuItem(menuItemPerfSynthStolen);
+  menuPagePerformance.addMenuItem(menuItemPerfEffectsCycles);
+  menuPagePerformance.addMenuItem(menuItemPerfEffectsBypassed);
+  menuPagePerformance.addMenuItem(menuItemPerfWavetables);
+}
+
 void menu_setup() { 
   menu.setSplashDelay(0);
   menu.init();
@@ -545,6 +748,23 @@ void menu_setup() {
   menuPageMain.addMenuItem(menuGotoSynth);
     menuPageSynth.addMenuItem(menuItemPlayback);  
     menuPageSynth.addMenuItem(menuItemWaveform);
+    menuPageSynth.addMenuItem(menuItemFMRatio);
+    menuPageSynth.addMenuItem(menuItemFMIndex);
+    menuPageSynth.addMenuItem(menuItemPolyphony);
+    menuPageSynth.addMenuItem(menuItemSteal);
+    menuPageSynth.addMenuItem(menuItemRetrigger);
+    menuPageSynth.addMenuItem(menuItemEnvAttack);
+    menuPageSynth.addMenuItem(menuItemEnvDecay);
+    menuPageSynth.addMenuItem(menuItemEnvSustain);
+    menuPageSynth.addMenuItem(menuItemEnvRelease);
+    menuPageSynth.addMenuItem(menuItemArpOrder);
+    menuPageSynth.addMenuItem(menuItemArpOctaves);
+    menuPageSynth.addMenuItem(menuItemArpStep);
+    menuPageSynth.addMenuItem(menuItemEffects);
+    menuPageSynth.addMenuItem(menuItemDelayTime);
+    menuPageSynth.addMenuItem(menuItemDelayFeedback);
+    menuPageSynth.addMenuItem(menuItemDelayMix);
+    menuPageSynth.addMenuItem(menuItemChorusMix);
     // menuItemAudioD added here for hardware V1.2
     menuPageSynth.addMenuItem(menuItemRolandMT32);
     menuPageSynth.addMenuItem(menuItemGeneralMidi);
@@ -560,6 +780,14 @@ void menu_setup() {
     menuPageAdvanced.addMenuItem(menuItemWheelAlt);
     menuPageAdvanced.addMenuItem(menuItemPBBehave);
     menuPageAdvanced.addMenuItem(menuItemModBehave);
+    if (pinGrid.is_analog()) {
+      menuPageAdvanced.addMenuItem(menuItemKeyRest);
+      menuPageAdvanced.addMenuItem(menuItemKeyBottom);
+      menuPageAdvanced.addMenuItem(menuItemKeySave);
+    }
+    menuPageAdvanced.addMenuItem(menuGotoPerformance);
+      createPerformanceMenuItems();
+      menuPagePerformance.addMenuItem(menuPerformanceBack);
     menuPageAdvanced.addMenuItem(menuItemUSBBootloader);
     menuPageAdvanced.addMenuItem(menuAdvancedBack);
   menuHome();
@@ -69,6 +69,101 @@ const uint8_t clarinet[] = {
   182, 183, 185, 189, 194, 201, 208, 217, 225, 234, 241, 248, 253, 255, 255, 252, 
   246, 237, 224, 209, 191, 171, 150, 127, 105,  84,  64,  46,  31,  18,   9,   2, 
 };
+/*
+  Correction for a downward step of 256 levels,
+  as a function of how far (0..255 = 0..1 sample)
+  the oscillator is from the step. This is the
+  polynomial band-limited step (PolyBLEP), i.e.
+  128 * (1 - x)^2, so that a step is spread over
+  the two samples either side of it instead of
+  landing on one. The naive step aliases badly
+  once a note is more than a few kHz.
+*/
+const uint8_t blep[] = {
+  128, 127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113,
+  112, 112, 111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 102, 101, 100,  99,
+   98,  97,  96,  95,  95,  94,  93,  92,  91,  90,  89,  89,  88,  87,  86,  85,
+   84,  84,  83,  82,  81,  80,  80,  79,  78,  77,  77,  76,  75,  74,  74,  73,
+   72,  71,  71,  70,  69,  68,  68,  67,  66,  65,  65,  64,  63,  63,  62,  61,
+   60,  60,  59,  58,  58,  57,  56,  56,  55,  54,  54,  53,  53,  52,  51,  51,
+   50,  49,  49,  48,  48,  47,  46,  46,  45,  45,  44,  43,  43,  42,  42,  41,
+   40,  40,  39,  39,  38,  38,  37,  37,  36,  36,  35,  35,  34,  34,  33,  33,
+   32,  32,  31,  31,  30,  30,  29,  29,  28,  28,  27,  27,  26,  26,  25,  25,
+   24,  24,  24,  23,  23,  22,  22,  22,  21,  21,  20,  20,  20,  19,  19,  18,
+   18,  18,  17,  17,  17,  16,  16,  15,  15,  15,  14,  14,  14,  13,  13,  13,
+   12,  12,  12,  12,  11,  11,  11,  10,  10,  10,  10,   9,   9,   9,   9,   8,
+    8,   8,   8,   7,   7,   7,   7,   6,   6,   6,   6,   5,   5,   5,   5,   5,
+    4,   4,   4,   4,   4,   4,   3,   3,   3,   3,   3,   3,   3,   2,   2,   2,
+    2,   2,   2,   2,   2,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0
+};
+/*
+  Mip-mapped wavetables. Played back as is, a table's
+  upper harmonics fold back down once a note is high
+  enough. So each table is also kept band-limited per
+  octave: level L keeps harmonics 1 to (128 >> L), and
+  each oscillator reads from the fullest level whose
+  top harmonic is still below half the sample rate.
+  The levels are built once at startup (see
+  synth_setup) from the table's harmonics.
+  The sine has no upper harmonics, so it is read as is.
+  Every table has a 257th entry, a copy of the first,
+  so the entry after any point can be read without
+  wrapping the index.
+  The "user" table is loaded from /wave.bin on the
+  flash (256 bytes, same format as the tables above),
+  or is a copy of the sine if there is no such file.
+*/
+#define WAVETABLE_LEVELS 8
+struct wavetable_obj {
+  uint8_t level[WAVETABLE_LEVELS][257];
+  void build(const uint8_t* src) {
+    float cosTable[256];
+    for (uint n = 0; n < 256; n++) {
+      cosTable[n] = cos(2.0 * PI * n / 256);
+    }
+    float re[129] = {0};
+    float im[129] = {0};
+    float dc = 0;
+    for (uint n = 0; n < 256; n++) {
+      dc += src[n];
+    }
+    dc /= 256;
+    for (uint h = 1; h <= 128; h++) {
+      for (uint n = 0; n < 256; n++) {
+        uint i = (h * n) & 255;
+        re[h] += src[n] * cosTable[i];
+        im[h] += src[n] * cosTable[(i + 192) & 255];  // sin = cos 90 degrees back
+      }
+      re[h] *= (h == 128 ? 1.0 : 2.0) / 256;
+      im[h] *= (h == 128 ? 1.0 : 2.0) / 256;
+    }
+    for (uint L = 0; L < WAVETABLE_LEVELS; L++) {
+      uint topHarmonic = (128 >> L);
+      for (uint n = 0; n < 256; n++) {
+        float v = dc;
+        for (uint h = 1; h <= topHarmonic; h++) {
+          uint i = (h * n) & 255;
+          v += re[h] * cosTable[i] + im[h] * cosTable[(i + 192) & 255];
+        }
+        level[L][n] = constrain(round(v), 0, 255);
+      }
+      level[L][256] = level[L][0];
+    }
+  }
+};
+uint8_t sineTable[257];
+wavetable_obj stringsTable;
+wavetable_obj clarinetTable;
+wavetable_obj userTable;
+// which level to play, given how far the counter moves per sample
+uint8_t wavetable_level(uint32_t increment) {
+  uint8_t L = 0;
+  while ((L < WAVETABLE_LEVELS - 1) && ((128u >> L) * (increment >> 16) > 32768)) {
+    ++L;
+  }
+  return L;
+}
 /*
   The hybrid synth sound blends between
   square, saw, and triangle waveforms
@@ -80,62 +175,62 @@ const uint8_t clarinet[] = {
   #define TRANSITION_SAW_HIGH  880.0
   #define TRANSITION_TRIANGLE 1760.0
 /*
-  The poll interval represents how often a
-  new sample value is emulated on the PWM
-  hardware. It is the inverse of the digital
-  audio sample rate. 24 microseconds has been
-  determined to be the sweet spot, and corresponds
-  to approximately 41 kHz, which is close to
-  CD-quality (44.1 kHz). A shorter poll interval
-  may produce more pleasant tones, but if the
-  poll is too short then the code will not have
-  enough time to calculate the new sample and
-  the resulting audio becomes unstable and
-  inaccurate. 
-*/
-#define POLL_INTERVAL_IN_MICROSECONDS 24
-/*
-  Eight voice polyphony can be simulated. 
-  Any more voices and the
-  resolution is too low to distinguish;
-  also, the code becomes too slow to keep
-  up with the poll interval. This value
-  can be safely reduced below eight if
-  there are issues.
+  Up to sixteen voices can be simulated.
+  How many are actually used is chosen in
+  the menu (synthPolyphony), and is held
+  back if measuring the synth shows that
+  many voices would take more than
+  SYNTH_CPU_BUDGET_PERCENT of the time
+  between two audio samples.
   
   Note this is NOT the same as the MIDI
   polyphony limit, which is 15 (based
   on using channel 2 through 16 for
   polyphonic expression mode).
 */
-#define POLYPHONY_LIMIT 8
+#define POLYPHONY_LIMIT 16
+#define SYNTH_CPU_BUDGET_PERCENT 75
 /*
   This class defines a virtual oscillator.
   It stores an oscillation frequency in
   the form of an increment value, which is
-  how much a counter would have to be increased
-  every time the poll() interval is reached, 
-  such that a counter overflows from 0 to 65,535
+  how much a 32-bit counter would have to be
+  increased every audio sample, such that
+  the counter overflows from 0 to 2^32 - 1
   back to zero at some frequency per second.
+  The increment is worked out from the sample
+  rate the audio output actually runs at, and
+  32 bits keep even the lowest notes within a
+  small fraction of a cent.
   
   The value of the counter is useful for reading
   a waveform sample, so that an analog signal
   can be emulated by reading the sample at each
   poll() based on how far the counter has moved
-  towards 65,536.
+  towards 2^32. The top 8 bits pick the table
+  entry, and the next 8 bits the point between
+  it and the next entry.
 */
 struct oscillator {
-  uint16_t increment = 0;
-  uint16_t counter = 0;
+  uint32_t baseIncrement = 0;   // the note itself, set on core 0
+  uint32_t appliedBase = 0;     // the base the increment was last worked out from
+  uint32_t increment = 0;       // the note with pitch bend and vibrato, set on core 1
+  uint32_t counter = 0;
+  uint32_t modCounter = 0;      // FM: the modulator's phase
+  uint8_t blepShift = 0;  // increment >> blepShift fits in 16 bits
+  uint32_t recip = 0;     // 2^24 / (increment >> blepShift), so the step correction needs no divide
+  uint8_t mip = 0;        // which band-limited level of a wavetable to read
   uint8_t a = 127;
   uint8_t b = 128;
   uint8_t c = 255;
   uint16_t ab = 0;
   uint16_t cd = 0;
-  void set_frequency(float f) { 
-    counter = 0;
-    increment = round(f * POLL_INTERVAL_IN_MICROSECONDS * 0.065536);   // cycle 0-65535 at resultant frequency
-    // synth[c].eq = isoTwoTwentySix(f);
+  uint8_t wrapStep = 0;   // hybrid: size of the drop when the counter wraps
+  uint8_t riseStep = 0;   // hybrid: size of the jump at "riseAt" (square shapes only)
+  uint32_t riseAt = 0;
+  // the note is set here; the synth bends it into "increment" once per block
+  void set_base(float f) {
+    baseIncrement = round(f * 4294967296.0 / audioOut.get_sample_rate());   // cycle 0 to 2^32 - 1 at resultant frequency
     if (currWave == WAVEFORM_HYBRID) {
       if (f < TRANSITION_SQUARE) {
         b = 128;
@@ -161,124 +256,1075 @@ struct oscillator {
         ab = 65535 / (b - a - 1);
       }
       cd = 65535 / (256 - c);
+      // the level at the top of the cycle drops to 0 when the counter wraps
+      if (c == 255) {
+        wrapStep = 255;
+      } else {
+        wrapStep = cd >> 8;
+      }
+      riseStep = ((b - a <= 1) ? 255 : 0);
+      riseAt = (uint32_t)(a + 1) << 24;
     }
   }
+  void set_increment(uint32_t inc) {
+    increment = inc;
+    blepShift = 0;
+    while ((increment >> blepShift) > 65535) {
+      ++blepShift;
+    }
+    recip = (increment ? (1u << 24) / (increment >> blepShift) : 0);
+    mip = wavetable_level(increment);
+  }
+  // unbent, for use outside the synth
+  void set_frequency(float f) {
+    set_base(f);
+    set_increment(baseIncrement);
+  }
 };
 
+/*
+  Pitch bend and vibrato are shared by all the voices.
+  Once per block, the bend plus the vibrato is turned
+  into one multiplier (16.16 fixed point) from these
+  tables, and each voice's increment is its note's
+  increment times that. Voices are only touched if the
+  multiplier or the note changed, and the phase carries
+  on, so moving the wheel does not click.
+  Offsets are in 1/256 semitones.
+*/
+#define VIBRATO_RATE_IN_HZ 5.5
+uint32_t pitchSemitone[12];    // 2^(k/12), 16.16
+uint32_t pitchFine[256];       // 2^(k/3072), 16.16
+void pitch_tables_setup() {
+  for (uint k = 0; k < 12; k++) {
+    pitchSemitone[k] = round(65536.0 * exp2(k / 12.0));
+  }
+  for (uint k = 0; k < 256; k++) {
+    pitchFine[k] = round(65536.0 * exp2(k / 3072.0));
+  }
+}
+uint32_t pitch_multiplier(int32_t offset) {
+  int32_t octaves = (offset >= 0 ? offset / 3072 : -((3071 - offset) / 3072));
+  uint32_t rest = offset - octaves * 3072;    // 0 .. 3071
+  uint32_t m = ((uint64_t)pitchSemitone[rest >> 8] * pitchFine[rest & 255]) >> 16;
+  return (octaves >= 0 ? m << octaves : m >> -octaves);
+}
+
+
+
+/*
+  Keys held down, for the mono synth and the arpeggiator.
+  Each key is kept twice: in pitch order, and in the order
+  it was played. Pressing or releasing a key moves at most
+  HELD_NOTE_LIMIT pointers; reading the n-th held note in
+  either order is a plain array lookup.
+  Keys are added and removed on core 0 and read by the
+  arpeggiator on core 1, so both sides take the lock.
+*/
+#include "pico/critical_section.h"
+#define HELD_NOTE_LIMIT 32
+struct held_notes_obj {
+  music_key_t* byPitch[HELD_NOTE_LIMIT];   // low to high
+  music_key_t* byPlay[HELD_NOTE_LIMIT];    // oldest first
+  uint count = 0;
+  critical_section_t lock;
+  void init() {
+    critical_section_init(&lock);
+    count = 0;
+  }
+  void clear() {
+    critical_section_enter_blocking(&lock);
+    count = 0;
+    critical_section_exit(&lock);
+  }
+  // returns false if already held or if there is no room
+  bool add(music_key_t* k) {
+    bool added = false;
+    critical_section_enter_blocking(&lock);
+    if ((count < HELD_NOTE_LIMIT) && (std::find(byPlay, byPlay + count, k) == byPlay + count)) {
+      uint i = count;
+      while ((i > 0) && (byPitch[i - 1]->frequency > k->frequency)) {
+        byPitch[i] = byPitch[i - 1];
+        --i;
+      }
+      byPitch[i] = k;
+      byPlay[count] = k;
+      ++count;
+      added = true;
+    }
+    critical_section_exit(&lock);
+    return added;
+  }
+  void remove(music_key_t* k) {
+    critical_section_enter_blocking(&lock);
+    auto p = std::remove(byPitch, byPitch + count, k);
+    std::remove(byPlay, byPlay + count, k);
+    count = p - byPitch;
+    critical_section_exit(&lock);
+  }
+  music_key_t* newest() {
+    return (count ? byPlay[count - 1] : nullptr);
+  }
+};
+held_notes_obj heldNotes;
+music_key_t* monoKey = nullptr;   // the key the mono synth is playing
 
+/*
+  The arpeggiator steps through the held notes, spread over
+  "arpOctaves" octaves, in the order chosen in the menu.
+  It is timed by the audio sample clock: the synth counts
+  samples down to the next step and cuts its render block
+  short there, so each step lands on an exact sample no
+  matter how busy core 0 is. Each step retriggers voice 1
+  and lets go of it after ARPEGGIO_GATE_PERCENT of the step.
+*/
+#define ARPEGGIO_GATE_PERCENT 75
+struct arpeggiator_obj {
+  uint32_t stepSamples = 2048;
+  uint32_t gateSamples = 1536;
+  uint32_t untilStep = 0;          // samples to the next step
+  uint32_t untilGateOff = 0;
+  uint32_t position = 0;           // steps since the arpeggio started
+  uint32_t randomState = 1;
+  volatile bool restart = false;   // set on core 0 when the first key goes down
+  // frequency of the next step, 0 if no key is held. core 1.
+  // and the velocity of the key it came from
+  float next_frequency(uint8_t& velocity) {
+    float f = 0;
+    critical_section_enter_blocking(&heldNotes.lock);
+    uint n = heldNotes.count;
+    if (n) {
+      uint span = n * arpOctaves;
+      uint p = position++;
+      uint i = 0;
+      switch (arpOrder) {
+        case ARP_UP:
+        case ARP_AS_PLAYED:
+          i = p % span;
+          break;
+        case ARP_DOWN:
+          i = span - 1 - p % span;
+          break;
+        case ARP_UP_DOWN:
+          if (span > 1) {
+            i = p % (2 * span - 2);
+            i = (i < span ? i : 2 * span - 2 - i);
+          }
+          break;
+        case ARP_RANDOM:
+          randomState ^= randomState << 13;   // xorshift
+          randomState ^= randomState >> 17;
+          randomState ^= randomState << 5;
+          i = randomState % span;
+          break;
+        default:
+          break;
+      }
+      music_key_t* k = (arpOrder == ARP_AS_PLAYED ? heldNotes.byPlay : heldNotes.byPitch)[i % n];
+      f = k->frequency * (1u << (i / n));
+      velocity = k->velocity;
+    }
+    critical_section_exit(&heldNotes.lock);
+    return f;
+  }
+};
+arpeggiator_obj arpeggiator;
 
-int arpeggiatingNow = UNUSED_NOTE;         // if this is 255, set to off (0% duty cycle)
-uint64_t arpeggiateTime = 0;                // Used to keep track of when this note started playing in ARPEG mode
-uint64_t arpeggiateLength = 65536;         // in microseconds. approx a 1/32 note at 114 BPM
+/*
+  Band-limiting correction for a downward step of 256
+  levels at phase 0, for an oscillator whose counter is
+  "phase" past the step. Only the sample either side of
+  the step is corrected, so most samples cost two compares.
+  Rising steps subtract it; smaller steps scale it.
+*/
+inline int polyblep(uint32_t phase, const oscillator& o) {
+  if (phase < o.increment) {
+    return blep[((phase >> o.blepShift) * o.recip) >> 16];
+  }
+  uint32_t left = -phase;         // how far to the step
+  if (left < o.increment) {
+    return -blep[((left >> o.blepShift) * o.recip) >> 16];
+  }
+  return 0;
+}
+// linear interpolation between the two table entries either side of the counter
+inline uint32_t table_lookup(const uint8_t* table, uint32_t counter) {
+  uint8_t t = counter >> 24;
+  int frac = (counter >> 16) & 255;
+  int a = table[t];
+  int b = table[t + 1];
+  return a + (((b - a) * frac) >> 8);
+}
+constexpr bool is_table_wave(uint8_t W) {
+  return (W == WAVEFORM_SINE) || (W == WAVEFORM_STRINGS) || (W == WAVEFORM_CLARINET) || (W == WAVEFORM_USER);
+}
+// the 257-entry table an oscillator reads for waveform W
+template <uint8_t W>
+inline const uint8_t* wave_table(const oscillator& o) {
+  if constexpr (W == WAVEFORM_STRINGS) {
+    return stringsTable.level[o.mip];
+  } else if constexpr (W == WAVEFORM_CLARINET) {
+    return clarinetTable.level[o.mip];
+  } else if constexpr (W == WAVEFORM_USER) {
+    return userTable.level[o.mip];
+  } else {
+    return sineTable;
+  }
+}
+/*
+  One sample of waveform W, for an oscillator whose
+  counter has just been advanced. Each waveform returns
+  an 8-bit level [0..255]. This is a template so that the
+  block renderer below gets a separate inner loop for
+  each waveform, with the switch done once per block.
+  The saw, square and hybrid shapes have steps in them,
+  which are band-limited with polyblep().
+*/
+template <uint8_t W>
+inline uint32_t wave_sample(const oscillator& o, uint32_t counter, uint8_t duty) {
+  uint8_t t = counter >> 24;      // 0 .. 255
+  if constexpr (W == WAVEFORM_SAW) {
+    return t + polyblep(counter, o);
+  } else if constexpr (W == WAVEFORM_TRIANGLE) {
+    return 2 * ((t >> 7) ? (255 - t) : t);
+  } else if constexpr (W == WAVEFORM_SQUARE) {
+    // up at (duty + 1) << 24, down at the wrap
+    return ((t > duty) ? 255 : 0) + polyblep(counter, o) - polyblep(counter - ((uint32_t)(duty + 1) << 24), o);
+  } else if constexpr (W == WAVEFORM_HYBRID) {
+    int level;
+    if (t <= o.a) {
+      level = 0;
+    } else if (t < o.b) {
+      level = ((t - o.a) * o.ab) >> 8;
+    } else if (t <= o.c) {
+      level = 255;
+    } else {
+      level = ((256 - t) * o.cd) >> 8;
+    }
+    if (o.wrapStep) {
+      level += (polyblep(counter, o) * o.wrapStep) >> 8;
+    }
+    if (o.riseStep) {
+      level -= (polyblep(counter - o.riseAt, o) * o.riseStep) >> 8;
+    }
+    return level;
+  } else if constexpr (is_table_wave(W)) {
+    return table_lookup(wave_table<W>(o), counter);
+  } else {
+    return 0;
+  }
+}
+/*
+  Two-operator FM. A sine modulator, running at an integer
+  multiple ("fmRatio") of the note, moves the phase of a
+  sine carrier. "depth" is how far the phase moves per
+  level of the modulator, so the peak swing is 127 * depth
+  out of a whole cycle of 2^32; the sum wraps like the
+  counters do. Both operators read the shared sine table.
+  The modulation index is fmIndex radians plus up to
+  FM_MOD_WHEEL_INDEX more from the mod wheel, and follows
+  the envelope, so notes get duller as they fade like a
+  bell or an electric piano.
+*/
+#define FM_MOD_WHEEL_INDEX 8
+// per 1/16 radian of index: 2^32 / (2 pi * 127 * 16)
+#define FM_DEPTH_PER_SIXTEENTH 336368u
+inline uint32_t fm_sample(uint32_t carrier, uint32_t modulator, uint32_t depth) {
+  int32_t m = (int32_t)table_lookup(sineTable, modulator) - 128;
+  return table_lookup(sineTable, carrier + (uint32_t)m * depth);
+}
+/*
+  Plucked string (Karplus-Strong). Each voice is a delay
+  line about one period long, filled with a burst of noise
+  when the note starts. Every sample, the oldest two values
+  are averaged (half a sample of delay, and the loss of high
+  partials that makes it sound like a string), scaled by
+  "loss" so the note dies away in about PLUCK_DECAY_S, and
+  written back. The part of the period that is not a whole
+  number of samples is made up by a first order allpass, so
+  any pitch, including microtonal ones, is in tune.
+  The lines are 16-bit, with the 8-bit wave level in the top.
+*/
+#define PLUCK_DECAY_S 2.0
+#define PLUCK_POOL_SAMPLES 8192
+struct pluck_voice_t {
+  uint32_t line = 0;            // start << 16 | length of its delay line in the pool, 0 if none. core 1 only
+  int32_t coef = 0;             // allpass, 1.15 fixed point
+  int32_t loss = 0;             // per sample, 1.15
+  uint32_t pos = 0;
+  int32_t prev = 0;
+  int32_t apIn = 0;
+  int32_t apOut = 0;
+  uint32_t generation = 0;      // of the pool, when the line was taken up
+  // the next note's line, posted under the pool lock by pluck_start()
+  // and taken up by core 1 before it renders the voice again, so the
+  // string is never changed under the renderer. 0 if none is waiting.
+  volatile uint32_t nextLine = 0;
+  int32_t nextCoef = 0;
+  int32_t nextLoss = 0;
+  // the whole samples of delay line needed for f.
+  // the rest (0.1 to 1.1 samples) is left to the allpass, which is
+  // only stable for a positive delay, so the line is never stretched
+  // to fit: 0 if f is too high to play (a period under 1.6 samples,
+  // which is above half the sample rate anyway).
+  static uint length_for(float f, uint rate) {
+    float whole = floor(rate / f - 0.6);
+    return (whole >= 1 ? whole : 0);
+  }
+  // the allpass and loss for f, on a line of len samples
+  void tune(uint len, float f, uint rate) {
+    float d = rate / f - 0.5 - len;
+    float w = 2 * PI * f / rate;
+    coef = round(32768.0 * sin((1.0 - d) * w / 2) / sin((1.0 + d) * w / 2));   // exactly d at f
+    float perPeriod = pow(10.0, -3.0 / (PLUCK_DECAY_S * f));    // -60 dB in PLUCK_DECAY_S
+    float g = std::min(perPeriod / cos(PI * f / rate), 1.0);     // less what the averaging takes
+    loss = round(32767.0 * pow(g, f / rate));
+  }
+  // fill the line with noise and start at the top of it
+  void pluck(int16_t* mem, uint len, uint32_t& seed) {
+    int32_t last = 0;
+    for (uint i = 0; i < len; i++) {
+      seed ^= seed << 13;   // xorshift
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      int32_t noise = (int32_t)(seed >> 16) - 32768;
+      mem[i] = (noise + last) >> 1;     // a little softer than white
+      last = noise;
+    }
+    pos = 0;
+    prev = 0;
+    apIn = 0;
+    apOut = 0;
+  }
+  void excite(int16_t* mem, uint len, float f, uint rate, uint32_t& seed) {
+    tune(len, f, rate);
+    pluck(mem, len, seed);
+  }
+  inline int32_t next(int16_t* mem, uint len) {
+    int32_t x = mem[pos];
+    int32_t d = (((x + prev) >> 1) * loss) >> 15;
+    prev = x;
+    int32_t y = constrain(((coef * (d - apOut)) >> 15) + apIn, -32768, 32767);   // no wrap in the line
+    apIn = d;
+    apOut = y;
+    mem[pos] = y;
+    if (++pos >= len) {
+      pos = 0;
+    }
+    return y;
+  }
+};
+/*
+  The delay lines come from one pool, set aside at boot.
+  A voice takes a line when its note starts and gives it
+  back when the voice is reclaimed, so low notes (long
+  lines) leave room for fewer voices than high ones.
+  A voice keeps the line it is playing until core 1 takes
+  up the next one, so it holds up to two: slot v, and the
+  waiting one in slot POLYPHONY_LIMIT + v. No line is
+  handed out while the renderer can still be writing it.
+  Both cores can start notes (the arpeggiator runs on
+  core 1), so the bookkeeping is done under a lock.
+*/
+struct pluck_pool_obj {
+  int16_t mem[PLUCK_POOL_SAMPLES];
+  uint16_t start[2 * POLYPHONY_LIMIT] = {};
+  uint16_t length[2 * POLYPHONY_LIMIT] = {};   // 0 = the slot has no line
+  volatile uint32_t generation = 0;            // moves on when the pool is cleared
+  critical_section_t lock;
+  void init() {
+    critical_section_init(&lock);
+    clear();
+  }
+  // call with the lock held. lines already being played are
+  // dropped by core 1 when it sees the generation change.
+  void clear() {
+    std::fill(std::begin(length), std::end(length), 0);
+    generation = generation + 1;
+  }
+  // call with the lock held. the first gap of n samples for voice v's
+  // next line, in place of any line already waiting for it.
+  // returns false if there is no room.
+  bool allocate(uint v, uint n, uint& at) {
+    uint w = POLYPHONY_LIMIT + v;
+    length[w] = 0;
+    bool found = false;
+    for (int c = -1; (c < 2 * POLYPHONY_LIMIT) && !found; c++) {
+      if ((c >= 0) && !length[c]) {
+        continue;
+      }
+      uint s = (c < 0 ? 0 : start[c] + length[c]);   // right after another line
+      found = (s + n <= PLUCK_POOL_SAMPLES);
+      for (uint o = 0; (o < 2 * POLYPHONY_LIMIT) && found; o++) {
+        found = (!length[o] || (s + n <= start[o]) || (start[o] + length[o] <= s));
+      }
+      if (found) {
+        start[w] = s;
+        length[w] = n;
+        at = s;
+      }
+    }
+    return found;
+  }
+  // call with the lock held. voice v's waiting line becomes the
+  // one it plays, and the old one goes back to the pool.
+  void take(uint v) {
+    uint w = POLYPHONY_LIMIT + v;
+    start[v] = start[w];
+    length[v] = length[w];
+    length[w] = 0;
+  }
+  void release(uint v) {
+    critical_section_enter_blocking(&lock);
+    length[v] = 0;
+    length[POLYPHONY_LIMIT + v] = 0;
+    critical_section_exit(&lock);
+  }
+  uint free_samples() {
+    uint used = 0;
+    for (auto n : length) {
+      used += n;
+    }
+    return PLUCK_POOL_SAMPLES - used;
+  }
+};
+pluck_pool_obj pluckPool;
+/*
+  Samples are rendered in blocks of up to this many
+  samples at a time. Anything that cannot change within
+  a block -- the waveform, the mod wheel, the velocity,
+  and the envelope steps -- is read once per block
+  instead of once per sample.
+*/
+#define SYNTH_BLOCK_SIZE 32
+/*
+  On the RP2040, the table waveforms can use the core's
+  hardware interpolator (INTERP0) as the oscillator.
+  Lane 0 adds the increment to the phase on each pop,
+  and lane 1 turns the phase into the address of the
+  table entry (table + top 8 bits of the phase), so a
+  single read moves the oscillator on and gives the
+  address to read. Each core has its own interpolators
+  and nothing else on core 1 uses INTERP0, so it is set
+  up again at the start of each render().
+  Define SYNTH_USES_INTERP as 0 to build without it.
+  Builds for anything but the RP2040 do, like the host
+  tests in test/. The software path gives the same
+  samples; at boot, synth_measure_costs() logs the cost
+  of both.
+*/
+#ifndef SYNTH_USES_INTERP
+  #ifdef ARDUINO_ARCH_RP2040
+    #define SYNTH_USES_INTERP 1
+  #else
+    #define SYNTH_USES_INTERP 0
+  #endif
+#endif
+#if SYNTH_USES_INTERP
+#include "hardware/interp.h"
+void synth_interp_setup() {
+  interp_config cfg = interp_default_config();
+  interp_config_set_add_raw(&cfg, true);      // lane 0: phase += increment
+  interp_set_config(interp0, 0, &cfg);
+  cfg = interp_default_config();
+  interp_config_set_cross_input(&cfg, true);  // lane 1: reads the phase from lane 0
+  interp_config_set_shift(&cfg, 24);
+  interp_config_set_mask(&cfg, 0, 7);
+  interp_set_config(interp0, 1, &cfg);
+}
+// mix one voice of a table waveform, returning the new phase
+inline uint32_t mix_table_voice_interp(int32_t* mix, uint len, const uint8_t* table,
+  uint32_t counter, uint32_t inc, int32_t e, int32_t de) {
+  interp0->accum[0] = counter + inc;          // the software path adds before it reads
+  interp0->base[0] = inc;
+  interp0->base[1] = (uintptr_t)table;
+  for (uint s = 0; s < len; s++) {
+    int frac = (interp0->accum[0] >> 16) & 255;
+    const uint8_t* p = (const uint8_t*)interp0->pop[1];
+    int a = p[0];
+    int b = p[1];
+    e += de;
+    mix[s] += (a + (((b - a) * frac) >> 8) - 128) * (e >> 16);
+  }
+  return interp0->accum[0] - inc;
+}
+#endif
+/*
+  Each voice has an ADSR envelope. It is moved on once
+  per block (the control rate), and the voice's level is
+  ramped across the block so the steps cannot be heard.
+  Levels are fixed point; ENV_FULL is full volume.
+  The attack, decay and release are straight lines, at
+  the rates worked out by synth_set_envelope().
+  Notes are started and stopped on core 0 but the
+  envelope runs on core 1, so core 0 only sets the gate
+  and counts triggers, and core 1 only sets the stage.
+  A released voice keeps sounding until its level is 0,
+  and is only then handed back to the open queue.
+*/
+#define ENV_FULL (1u << 24)
+enum {
+  env_off, env_attack, env_decay, env_sustain, env_release
+};
+struct envelope_rates_t {
+  uint32_t attack = ENV_FULL;     // level change per sample
+  uint32_t decay = ENV_FULL;
+  uint32_t sustain = ENV_FULL;    // a level
+  uint32_t release = ENV_FULL;
+};
+envelope_rates_t envRates;
+// per-sample step to cover the full level range in "mS"
+uint32_t envelope_step(int mS) {
+  uint samples = (uint)mS * audioOut.get_sample_rate() / 1000;
+  return ENV_FULL / std::max(samples, 1u);
+}
+void synth_set_envelope() {
+  envRates.attack  = envelope_step(envAttack_mS);
+  envRates.decay   = envelope_step(envDecay_mS);
+  envRates.sustain = (ENV_FULL / 127) * envSustain;
+  envRates.release = envelope_step(envRelease_mS);
+}
+struct envelope {
+  volatile bool gate = false;     // written by core 0
+  volatile uint8_t trigger = 0;   // written by core 0
+  volatile uint8_t seen = 0;      // written by core 1
+  volatile uint8_t stage = env_off;
+  uint32_t level = 0;
+  void note_on() {
+    gate = true;
+    ++trigger;
+  }
+  void note_off() {
+    gate = false;
+  }
+  bool is_silent() {
+    return (!gate) && (stage == env_off) && (trigger == seen);
+  }
+  // move on by "len" samples and return the new level
+  uint32_t advance(uint len, const envelope_rates_t& r) {
+    if (trigger != seen) {
+      seen = trigger;
+      stage = env_attack;
+    } else if ((!gate) && (stage != env_off)) {
+      stage = env_release;
+    }
+    uint32_t step;
+    switch (stage) {
+      case env_attack:
+        step = r.attack * len;
+        if (level + step >= ENV_FULL) {
+          level = ENV_FULL;
+          stage = env_decay;
+        } else {
+          level += step;
+        }
+        break;
+      case env_decay:
+        step = r.decay * len;
+        if (level <= r.sustain + step) {
+          level = r.sustain;
+          stage = env_sustain;
+        } else {
+          level -= step;
+        }
+        break;
+      case env_sustain:
+        level = r.sustain;  // follows the menu setting
+        break;
+      case env_release:
+        step = r.release * len;
+        if (level <= step) {
+          level = 0;
+          stage = env_off;
+        } else {
+          level -= step;
+        }
+        break;
+      default:
+        level = 0;
+        break;
+    }
+    return level;
+  }
+};
 
 struct synth_obj {
-  std::vector<oscillator> channel;
-  byte_queue open_queue;
-  const uint8_t attenuation[9] = {64,24,17,14,12,11,10,9,8}; // full volume in mono mode; equalized volume in poly.
+  oscillator channel[POLYPHONY_LIMIT];
+  envelope env[POLYPHONY_LIMIT];
+  uint32_t pitchMult = 0;      // the multiplier the voices were last bent by
+  uint32_t lfoPhase = 0;
+  uint32_t lfoIncrement = 0;   // per sample
+  // the wheels the synth follows. a copy used for testing can be
+  // pointed at its own values so the live wheels are left alone.
+  const int16_t* bendWheel = &pbWheel.curValue;
+  const int16_t* modulation = &modWheel.curValue;
+  bool live = false;   // only the live synth follows the arpeggiator and plucks from the pool
+  pluck_voice_t pluck[POLYPHONY_LIMIT];
+  uint32_t pluckSeed = 1;
+  uint8_t velocity[POLYPHONY_LIMIT];   // of each voice's note, 0..127; scales its envelope
+  bool useInterp = SYNTH_USES_INTERP;   // table waveforms use the hardware interpolator
+  // gain in poly mode, by the sum of the envelope levels in 1/4 voices.
+  // full volume for one voice in mono mode is 64.
+  uint8_t polyGain[4 * POLYPHONY_LIMIT + 1];
 
   void init() {
-    channel.resize(POLYPHONY_LIMIT);
+    for (auto& i : channel) {
+      i = oscillator();
+    }
+    for (auto& e : env) {
+      e = envelope();
+    }
+    for (auto& p : pluck) {
+      p = pluck_voice_t();
+    }
+    std::fill(std::begin(velocity), std::end(velocity), 127);
+    for (uint q = 0; q <= 4 * POLYPHONY_LIMIT; q++) {
+      polyGain[q] = round(24.0 / sqrt(std::max(q, 4u) / 4.0));
+    }
+    pitchMult = 0;
+    live = false;
+    lfoPhase = 0;
+    lfoIncrement = round(VIBRATO_RATE_IN_HZ * 4294967296.0 / audioOut.get_sample_rate());
   }
   void setFreq(float frequency, uint8_t ch) {
-    float f = frequency * exp2(pbWheel.curValue * PITCH_BEND_SEMIS / 98304.0);
-    sendToLog("set synth ch " + std::to_string(ch) + " to " + std::to_string(f));
-    channel[ch - 1].set_frequency(f);
+    sendToLog("set synth ch " + std::to_string(ch) + " to " + std::to_string(frequency));
+    channel[ch - 1].set_base(frequency);
   }
-  
-  uint8_t next_sample() {
-    uint32_t mix = 0;
-    uint8_t voices = 0;
+  // control rate: bend every voice by the wheel and the vibrato,
+  // then move the vibrato on by "len" samples.
+  void apply_pitch(uint len) {
+    int32_t offset = ((int32_t)*bendWheel * PITCH_BEND_SEMIS) / 32;   // 8192 = the bend range
+    offset += ((int32_t)sineTable[lfoPhase >> 24] - 128) * *modulation >> 7;  // up to 1/2 semitone
+    lfoPhase += lfoIncrement * len;
+    uint32_t mult = pitch_multiplier(offset);
+    bool changed = (mult != pitchMult);
+    pitchMult = mult;
     for (auto& i : channel) {
-      if (i.increment) {
-        i.counter += i.increment; // should overflow from 65536 -> 0        
-        uint8_t t = i.counter >> 8;       // 0 .. 255
+      if (changed || (i.appliedBase != i.baseIncrement)) {
+        i.appliedBase = i.baseIncrement;
+        i.set_increment(((uint64_t)i.appliedBase * mult) >> 16);
+      }
+    }
+  }
+  // give voice v a new delay line, to be plucked by core 1 before it
+  // next renders the voice. false if the pool is full; the voice
+  // keeps sounding on its old line.
+  bool pluck_start(float frequency, uint v) {
+    if (!live) {
+      return false;
+    }
+    uint rate = audioOut.get_sample_rate();
+    uint len = pluck_voice_t::length_for(frequency, rate);
+    if (!len || (len > 0xFFFF)) {
+      return false;
+    }
+    pluck_voice_t tuned;
+    tuned.tune(len, frequency, rate);   // the float math stays off the lock
+    uint at = 0;
+    pluck_voice_t& p = pluck[v];
+    critical_section_enter_blocking(&pluckPool.lock);
+    bool found = pluckPool.allocate(v, len, at);
+    p.nextCoef = tuned.coef;
+    p.nextLoss = tuned.loss;
+    p.nextLine = (found ? (at << 16) | len : 0);
+    critical_section_exit(&pluckPool.lock);
+    return found;
+  }
+  // core 1: voice v takes up the line pluck_start() left for it
+  void pluck_take(uint v) {
+    pluck_voice_t& p = pluck[v];
+    critical_section_enter_blocking(&pluckPool.lock);
+    uint32_t desc = p.nextLine;
+    if (desc) {
+      p.nextLine = 0;
+      p.coef = p.nextCoef;
+      p.loss = p.nextLoss;
+      p.generation = pluckPool.generation;
+      pluckPool.take(v);
+    }
+    critical_section_exit(&pluckPool.lock);
+    if (desc) {
+      p.pluck(pluckPool.mem + (desc >> 16), desc & 0xFFFF, pluckSeed);   // no one else has this line
+      p.line = desc;
+    }
+  }
+  // false if the note could not be started
+  bool note_on(float frequency, uint8_t ch, uint8_t vel = 127) {
+    if ((currWave == WAVEFORM_PLUCK) && !pluck_start(frequency, ch - 1)) {
+      return false;
+    }
+    setFreq(frequency, ch);
+    velocity[ch - 1] = vel;
+    env[ch - 1].note_on();
+    return true;
+  }
+  void note_off(uint8_t ch) {
+    env[ch - 1].note_off();
+  }
+  // FM depth at full envelope, see fm_sample()
+  uint32_t fm_depth() {
+    uint32_t sixteenths = 16 * fmIndex + (16 * FM_MOD_WHEEL_INDEX * *modulation) / 127;
+    return sixteenths * FM_DEPTH_PER_SIXTEENTH;
+  }
+  uint8_t duty_from_mod_wheel() {
+    // duty cycle = 50% when mod = min; 6.25% when mod = max
+    return 128 - (*modulation >> 3) * 7;
+  }
+  uint8_t active_voices() {
+    uint8_t voices = 0;
+    for (auto& e : env) {
+      voices += (e.stage != env_off);
+    }
+    return voices;
+  }
+  // the envelope of a voice, scaled by the velocity of its note
+  int32_t scaled_level(uint v, int32_t level) {
+    return (level >> 7) * velocity[v];
+  }
+  // [6bit] << 7, from the sum of the envelope levels. each voice's
+  // velocity is already in its envelope, see scaled_level().
+  uint32_t gain_for(uint32_t envSum) {
+    if (playbackMode != SYNTH_POLY) {
+      return 64 << 7;
+    }
+    uint q = std::min((envSum + (ENV_FULL >> 2) - 1) >> 22, 4u * POLYPHONY_LIMIT);
+    return polyGain[q] << 7;
+  }
+  // each voice adds [8bit signed]*env[8bit]; *gain[13bit] = [29bit]; - [13bit] = [16bit]
+  audio_sample to_output(int32_t mix, uint32_t gain) {
+    return constrain(32768 + ((mix * (int32_t)gain) >> 13), 0, 65535);
+  }
+  
+  // one sample at a time. kept for comparison with render().
+  audio_sample next_sample() {
+    int32_t mix = 0;
+    uint32_t envSum = 0;
+    uint8_t duty = duty_from_mod_wheel();
+    uint32_t depth = fm_depth() >> 8;
+    apply_pitch(1);
+    for (uint v = 0; v < POLYPHONY_LIMIT; v++) {
+      oscillator& i = channel[v];
+      uint32_t e = env[v].advance(1, envRates);
+      envSum += e;
+      if (e) {
+        i.counter += i.increment; // should overflow from 2^32 -> 0        
+        int level = 128;
         switch (currWave) {
-          case WAVEFORM_SAW:
-            mix += i.counter;
-            break;
-          case WAVEFORM_TRIANGLE:
-            mix += 2 * ((t >> 7) ? t : (256 - t));
+          case WAVEFORM_SAW:      level = wave_sample<WAVEFORM_SAW>(i, i.counter, duty);      break;
+          case WAVEFORM_TRIANGLE: level = wave_sample<WAVEFORM_TRIANGLE>(i, i.counter, duty); break;
+          case WAVEFORM_SQUARE:   level = wave_sample<WAVEFORM_SQUARE>(i, i.counter, duty);   break;
+          case WAVEFORM_HYBRID:   level = wave_sample<WAVEFORM_HYBRID>(i, i.counter, duty);   break;
+          case WAVEFORM_SINE:     level = wave_sample<WAVEFORM_SINE>(i, i.counter, duty);     break;
+          case WAVEFORM_STRINGS:  level = wave_sample<WAVEFORM_STRINGS>(i, i.counter, duty);  break;
+          case WAVEFORM_CLARINET: level = wave_sample<WAVEFORM_CLARINET>(i, i.counter, duty); break;
+          case WAVEFORM_USER:     level = wave_sample<WAVEFORM_USER>(i, i.counter, duty);     break;
+          case WAVEFORM_FM:
+            i.modCounter += i.increment * fmRatio;
+            level = fm_sample(i.counter, i.modCounter, depth * (e >> 16));
             break;
-          case WAVEFORM_SQUARE:
-            // duty cycle = 50% when mod = min; 6.25% when mod = max
-            mix += ((t > (128 - (modWheel.curValue >> 3) * 7)) ? 255 : 0);   break;
-          case WAVEFORM_HYBRID:
-            if (t > i.a) {
-              uint16_t p = 65535; 
-              if (t < i.b) {
-                p = ((t - i.a) * i.ab) >> 8;
-              } else if (t <= i.c) {
-                mix += 255;
-              } else {
-                p = ((256 - t) * i.cd) >> 8;
-              }
+          case WAVEFORM_PLUCK:
+            if (pluck[v].line) {
+              level = 128 + (pluck[v].next(pluckPool.mem + (pluck[v].line >> 16), pluck[v].line & 0xFFFF) >> 8);
             }
             break;
-          case WAVEFORM_SINE:     
-            mix += sine[t];                                   
-            break;
-          case WAVEFORM_STRINGS:  
-            mix += strings[t];                                
-            break;
-          case WAVEFORM_CLARINET: 
-            mix += clarinet[t];                               
-            break;
           default:
             break;
         }
-        ++voices;
+        mix += (level - 128) * (scaled_level(v, e) >> 16);
+      }
+    }
+    return to_output(mix, gain_for(envSum));
+  }
+
+  // add each sounding voice of waveform W into the mix, and move
+  // its envelope on by one block. the level is ramped from where
+  // the envelope was to where it is now, across the block.
+  // the oscillator state is kept in locals for the whole block.
+  // returns the sum of the envelope levels.
+  template <uint8_t W>
+  uint32_t mix_voices(int32_t* mix, uint len, uint8_t duty) {
+    uint32_t envSum = 0;
+    uint32_t fmDepth = 0;
+    uint32_t ratio = fmRatio;
+    if constexpr (W == WAVEFORM_FM) {
+      fmDepth = fm_depth() >> 8;
+    }
+    for (uint v = 0; v < POLYPHONY_LIMIT; v++) {
+      oscillator& i = channel[v];
+      int32_t from = env[v].level;
+      int32_t to = env[v].advance(len, envRates);
+      envSum += to;
+      if (from | to) {
+        uint32_t inc = i.increment;
+        uint32_t counter = i.counter;
+        int32_t e = scaled_level(v, from);
+        int32_t de = (scaled_level(v, to) - e) / (int32_t)len;
+        if constexpr (W == WAVEFORM_PLUCK) {
+          pluck_voice_t& p = pluck[v];
+          if (p.nextLine) {
+            pluck_take(v);
+          }
+          if (p.generation != pluckPool.generation) {
+            p.line = 0;   // the pool was cleared under it
+          }
+          uint32_t desc = p.line;
+          if (desc) {
+            int16_t* mem = pluckPool.mem + (desc >> 16);
+            uint lineLength = desc & 0xFFFF;
+            if (p.pos >= lineLength) {
+              p.pos = 0;
+            }
+            for (uint s = 0; s < len; s++) {
+              e += de;
+              mix[s] += (p.next(mem, lineLength) >> 8) * (e >> 16);
+            }
+          }
+          continue;
+        }
+        if constexpr (W == WAVEFORM_FM) {
+          uint32_t modInc = inc * ratio;
+          uint32_t modCounter = i.modCounter;
+          uint32_t depth = fmDepth * (uint32_t)(to >> 16);    // the index follows the envelope
+          for (uint s = 0; s < len; s++) {
+            counter += inc;
+            modCounter += modInc;
+            e += de;
+            mix[s] += ((int32_t)fm_sample(counter, modCounter, depth) - 128) * (e >> 16);
+          }
+          i.counter = counter;
+          i.modCounter = modCounter;
+          continue;
+        }
+        #if SYNTH_USES_INTERP
+        if constexpr (is_table_wave(W)) {
+          if (useInterp) {
+            i.counter = mix_table_voice_interp(mix, len, wave_table<W>(i), counter, inc, e, de);
+            continue;
+          }
+        }
+        #endif
+        for (uint s = 0; s < len; s++) {
+          counter += inc;
+          e += de;
+          mix[s] += ((int32_t)wave_sample<W>(i, counter, duty) - 128) * (e >> 16);
+        }
+        i.counter = counter;
+      }
+    }
+    return envSum;
+  }
+  // play an arpeggio step or end its gate if one is due now,
+  // and return how many of the next "len" samples to render
+  // before the next one is due.
+  uint arpeggio_step(uint len) {
+    arpeggiator_obj& a = arpeggiator;
+    if (a.restart) {
+      a.restart = false;
+      a.position = 0;
+      a.untilStep = 0;
+    }
+    if (env[0].gate && !a.untilGateOff) {
+      env[0].note_off();
+    }
+    if (!a.untilStep) {
+      uint8_t vel = 127;
+      float f = a.next_frequency(vel);
+      if ((f > 0) && ((currWave != WAVEFORM_PLUCK) || pluck_start(f, 0))) {
+        channel[0].set_base(f);
+        velocity[0] = vel;
+        env[0].note_on();
+      }
+      a.untilStep = a.stepSamples;
+      a.untilGateOff = a.gateSamples;
+    }
+    len = std::min(len, a.untilStep);
+    if (env[0].gate) {
+      len = std::min(len, a.untilGateOff);
+      a.untilGateOff -= len;
+    }
+    a.untilStep -= len;
+    return len;
+  }
+  // write n samples into out, a block at a time.
+  void render(audio_sample* out, uint n) {
+    render(out, n, currWave);
+  }
+  void render(audio_sample* out, uint n, uint8_t wave) {
+    #if SYNTH_USES_INTERP
+    if (useInterp) {
+      synth_interp_setup();
+    }
+    #endif
+    uint8_t duty = duty_from_mod_wheel();
+    while (n) {
+      uint len = std::min(n, (uint)SYNTH_BLOCK_SIZE);
+      if (live && (playbackMode == SYNTH_ARPEGGIO)) {
+        len = arpeggio_step(len);
+      }
+      int32_t mix[SYNTH_BLOCK_SIZE] = {0};
+      apply_pitch(len);
+      uint32_t envSum = 0;
+      switch (wave) {
+        case WAVEFORM_SAW:      envSum = mix_voices<WAVEFORM_SAW>(mix, len, duty);      break;
+        case WAVEFORM_TRIANGLE: envSum = mix_voices<WAVEFORM_TRIANGLE>(mix, len, duty); break;
+        case WAVEFORM_SQUARE:   envSum = mix_voices<WAVEFORM_SQUARE>(mix, len, duty);   break;
+        case WAVEFORM_HYBRID:   envSum = mix_voices<WAVEFORM_HYBRID>(mix, len, duty);   break;
+        case WAVEFORM_SINE:     envSum = mix_voices<WAVEFORM_SINE>(mix, len, duty);     break;
+        case WAVEFORM_STRINGS:  envSum = mix_voices<WAVEFORM_STRINGS>(mix, len, duty);  break;
+        case WAVEFORM_CLARINET: envSum = mix_voices<WAVEFORM_CLARINET>(mix, len, duty); break;
+        case WAVEFORM_USER:     envSum = mix_voices<WAVEFORM_USER>(mix, len, duty);     break;
+        case WAVEFORM_FM:       envSum = mix_voices<WAVEFORM_FM>(mix, len, duty);       break;
+        case WAVEFORM_PLUCK:    envSum = mix_voices<WAVEFORM_PLUCK>(mix, len, duty);    break;
+        default:
+          break;
       }
+      uint32_t gain = gain_for(envSum);
+      for (uint s = 0; s < len; s++) {
+        out[s] = to_output(mix[s], gain);
+      }
+      out += len;
+      n -= len;
     }
-    mix *= attenuation[(playbackMode == SYNTH_POLY) * voices]; // [8bit]*atten[6bit] = [14bit]
-    mix *= velWheel.curValue; // [14bit]*vel[7bit]=[21bit] 
-    return (mix >> 13);  // [21bit] - [8bit] = [13bit]
   }
 };
 
 synth_obj synth;
 
-// USE THIS IN MONO OR ARPEG MODE ONLY
-// return the hex index of the next held note.
-// kind of messy but works.
-uint8_t findNextHeldNote() {
-  // arpeggiatingNow refers to a pixel number currently.
-  // so first find the note that matches it.
-  // then iterate through all the notes until next note is found,
-  // and return its pixel.
 /*
-  auto findArpeggiatingNow = &hexBoard.key_at_pixel(arpeggiatingNow);
-  
-  if (findArpeggiatingNow != hexBoard.keys.end() - 1) {
-    for (auto i = findArpeggiatingNow + 1; i != hexBoard.keys.end(); ++i) {
-      if (i->MIDIch) {
-        return i->pixel;
+  Effects on the mixed synth output: a feedback delay and a
+  light chorus. Both read from one circular buffer, set aside
+  at compile time, that holds the output plus what is fed
+  back. Define EFFECTS_BUFFER_SAMPLES (a power of two, up to
+  65536) to trade memory for the longest delay.
+  Taps between two samples are read by linear interpolation,
+  so the chorus can sweep smoothly, and a new delay time
+  glides in rather than jumping.
+  This runs on core 1 after every render. It measures its own
+  cost, and if the audio starts to run late (the buffer ran
+  dry, or a timer tick was missed) it steps aside for
+  EFFECTS_BYPASS_MS so the synth can catch up.
+*/
+#ifndef EFFECTS_BUFFER_SAMPLES
+  #define EFFECTS_BUFFER_SAMPLES 16384
+#endif
+static_assert(!(EFFECTS_BUFFER_SAMPLES & (EFFECTS_BUFFER_SAMPLES - 1)) && (EFFECTS_BUFFER_SAMPLES <= 65536),
+  "EFFECTS_BUFFER_SAMPLES must be a power of two, up to 65536");
+#define EFFECTS_BYPASS_MS 1000
+#define CHORUS_RATE_IN_HZ 0.8
+#define CHORUS_DELAY_MS 12.0
+#define CHORUS_DEPTH_MS 4.0
+struct effects_obj {
+  int16_t line[EFFECTS_BUFFER_SAMPLES];
+  uint32_t write = 0;
+  uint32_t filled = 0;          // samples written since the line was last emptied
+  uint32_t delayQ16 = 0;        // in samples, 16.16, gliding towards the target
+  uint32_t delayTargetQ16 = 0;
+  int32_t feedback = 0;         // 1.15
+  int32_t delayLevel = 0;       // 1.15
+  int32_t chorusLevel = 0;      // 1.15
+  uint32_t lfoPhase = 0;
+  uint32_t lfoIncrement = 0;
+  uint32_t chorusBaseQ16 = 0;
+  uint32_t chorusDepthQ8 = 0;   // so that depth * (16-bit sweep) fits in 32 bits
+  uint32_t bypassSamples = 0;
+  uint32_t bypassHold = 0;
+  uint lastUnderruns = 0;
+  uint lastLateTicks = 0;
+  volatile uint32_t cycles = 0;     // per sample, averaged, in 1/16 cycles
+  volatile uint bypassed = 0;       // times it stepped aside
+  volatile bool enabled = false;
+  volatile bool changed = false;
+  void setup(uint rate) {
+    lfoIncrement = CHORUS_RATE_IN_HZ * 4294967296.0 / rate;
+    chorusBaseQ16 = CHORUS_DELAY_MS * rate / 1000 * 65536;
+    chorusDepthQ8 = CHORUS_DEPTH_MS * rate / 1000 * 256;
+    bypassHold = (uint64_t)EFFECTS_BYPASS_MS * rate / 1000;
+  }
+  // the sample "delay" (16.16) samples before the one about to be written
+  inline int32_t tap(uint32_t delay) {
+    uint32_t at = (write << 16) - delay;
+    int32_t older = line[(at >> 16) & (EFFECTS_BUFFER_SAMPLES - 1)];
+    int32_t newer = line[((at >> 16) + 1) & (EFFECTS_BUFFER_SAMPLES - 1)];
+    return older + (((newer - older) * (int32_t)(at & 0xFFFF)) >> 16);
+  }
+  // true while the audio is under pressure, checked once per block
+  bool under_pressure(uint n) {
+    uint underruns = audioOut.get_underruns();
+    uint late = task_mgr.get_late_ticks();
+    if ((underruns > lastUnderruns) || (late > lastLateTicks)) {   // not when the stats are reset
+      if (!bypassSamples) {
+        ++bypassed;
       }
+      bypassSamples = bypassHold;
+    }
+    lastUnderruns = underruns;
+    lastLateTicks = late;
+    bool wasBypassed = bypassSamples;
+    bypassSamples -= std::min(bypassSamples, n);
+    if (wasBypassed && !bypassSamples) {
+      filled = 0;   // no stale echoes on the way back
     }
+    return wasBypassed;
   }
-  if (findArpeggiatingNow > hexBoard.keys.begin()) {
-    for (auto i = hexBoard.keys.begin(); i != findArpeggiatingNow; ++i) {
-      if (i->MIDIch) {
-        return i->pixel;
+  void process(audio_sample* out, uint n) {
+    if (!enabled) {
+      return;
+    }
+    uint32_t start = rp2040.getCycleCount();
+    if (changed) {
+      changed = false;
+      filled = 0;
+    }
+    if (under_pressure(n)) {
+      return;
+    }
+    delayQ16 += ((int32_t)(delayTargetQ16 - delayQ16)) >> 6;   // glide over a few dozen blocks
+    bool delayOn = delayLevel || feedback;
+    // the line is emptied by writing over it, not by clearing it in
+    // one go, so a tap stays quiet until it reaches only new samples.
+    uint32_t fresh = filled;
+    for (uint s = 0; s < n; s++) {
+      int32_t x = (int32_t)out[s] - 32768;
+      int32_t delayed = ((delayOn && ((delayQ16 >> 16) < fresh)) ? tap(delayQ16) : 0);
+      int32_t y = x + ((delayed * delayLevel) >> 15);
+      if (chorusLevel) {
+        lfoPhase += lfoIncrement;
+        uint32_t sweep = (lfoPhase ^ ((int32_t)lfoPhase >> 31)) >> 15;   // triangle, 0..65535
+        uint32_t chorusQ16 = chorusBaseQ16 + ((chorusDepthQ8 * sweep) >> 8);
+        if ((chorusQ16 >> 16) < fresh) {
+          y += (tap(chorusQ16) * chorusLevel) >> 15;
+        }
       }
+      line[write] = constrain(x + ((delayed * feedback) >> 15), -32768, 32767);
+      write = (write + 1) & (EFFECTS_BUFFER_SAMPLES - 1);
+      out[s] = constrain(y + 32768, 0, 65535);
+      ++fresh;
     }
+    filled = std::min<uint32_t>(fresh, EFFECTS_BUFFER_SAMPLES);
+    uint32_t perSample = ((rp2040.getCycleCount() - start) << 4) / n;
+    cycles = cycles - (cycles >> 4) + (perSample >> 4);   // smoothed over about 16 blocks
   }
-*/
-  return UNUSED_NOTE;
-}
+};
+effects_obj effects;
 
-void replaceMonoSynthWith(int x) {
-  if (arpeggiatingNow == x) return;
-  hexBoard.key_at_pixel(arpeggiatingNow).synthCh = 0;
-  arpeggiatingNow = x;
-  if (arpeggiatingNow != UNUSED_NOTE) {
-    hexBoard.key_at_pixel(arpeggiatingNow).synthCh = 1;
-    synth.setFreq(hexBoard.key_at_pixel(arpeggiatingNow).frequency, 1);
+// the mono synth plays the newest held key, or stops
+void playMonoSynth() {
+  music_key_t* k = heldNotes.newest();
+  if (k == monoKey) return;
+  if (monoKey) {
+    monoKey->synthCh = 0;
+  }
+  monoKey = k;
+  if (monoKey) {
+    monoKey->synthCh = 1;
+    synth.note_on(monoKey->frequency, 1, monoKey->velocity);
   } else {
-    synth.setFreq(0, 1);
+    synth.note_off(1);
   }
 }
 
-// pass all notes thru synth again if the pitch bend changes
+// pass all notes thru synth again if their frequencies change (e.g. transpose).
+// the pitch bend wheel does not need this, the synth reads it every block.
 void updateSynthWithNewFreqs() {
   for (auto& h : hexBoard.keys) {
     if (h.synthCh) {
@@ -287,34 +1333,166 @@ void updateSynthWithNewFreqs() {
   }
 }
 
+/*
+  Hands out the poly synth voices. Free voices are kept
+  on a stack, so taking and returning one is O(1) with
+  no heap use. A released voice is not free until its
+  envelope is silent; until then it can be taken back
+  by the same key (retrigger). If no voice is free, one
+  is stolen: the oldest or the quietest, preferring
+  voices already in their release over held ones.
+*/
+struct voice_alloc_obj {
+  uint8_t freeStack[POLYPHONY_LIMIT];
+  uint8_t freeCount = 0;
+  music_key_t* owner[POLYPHONY_LIMIT] = {};    // the key holding the voice, if any
+  music_key_t* lastKey[POLYPHONY_LIMIT] = {};  // the key that played it last
+  uint32_t startedAt[POLYPHONY_LIMIT] = {};    // note-on count, for "oldest"
+  uint32_t inUse = 0;       // bit (ch - 1) is set while the voice is held or releasing
+  uint32_t releasing = 0;   // bit (ch - 1) is set while the voice is releasing
+  uint32_t noteCount = 0;
+  uint voices = 0;
+  uint dropped = 0;
+  uint stolen = 0;
+  void reset(uint arg_voices) {
+    voices = std::min(arg_voices, (uint)POLYPHONY_LIMIT);
+    freeCount = 0;
+    for (uint v = voices; v > 0; v--) {
+      freeStack[freeCount++] = v - 1;   // voice 1 on top
+    }
+    for (uint v = 0; v < POLYPHONY_LIMIT; v++) {
+      owner[v] = nullptr;
+      lastKey[v] = nullptr;
+    }
+    inUse = 0;
+    releasing = 0;
+  }
+  void take(uint v, music_key_t* h) {
+    if (owner[v]) {
+      owner[v]->synthCh = 0;    // stolen from a held key
+    }
+    owner[v] = h;
+    lastKey[v] = h;
+    startedAt[v] = ++noteCount;
+    inUse |= (1u << v);
+    releasing &= ~(1u << v);
+  }
+  // the voice (0-based) that the policy would steal, or -1
+  int victim(uint8_t policy) {
+    if (policy == STEAL_OFF) {
+      return -1;
+    }
+    uint32_t pool = (releasing ? releasing : inUse);
+    int best = -1;
+    uint32_t bestScore = UINT32_MAX;
+    while (pool) {
+      uint v = __builtin_ctz(pool);
+      pool &= pool - 1;
+      uint32_t score = (policy == STEAL_QUIETEST ? synth.env[v].level : startedAt[v]);
+      if (score < bestScore) {
+        bestScore = score;
+        best = v;
+      }
+    }
+    return best;
+  }
+  // returns the synth channel (1-based), or 0 if the note is dropped
+  uint8_t allocate(music_key_t* h, uint8_t policy, bool retrigger) {
+    if (retrigger) {
+      uint32_t r = releasing;
+      while (r) {
+        uint v = __builtin_ctz(r);
+        r &= r - 1;
+        if (lastKey[v] == h) {
+          take(v, h);
+          return v + 1;
+        }
+      }
+    }
+    if (freeCount) {
+      uint v = freeStack[--freeCount];
+      take(v, h);
+      return v + 1;
+    }
+    int v = victim(policy);
+    if (v < 0) {
+      ++dropped;
+      return 0;
+    }
+    ++stolen;
+    take(v, h);
+    return v + 1;
+  }
+  void release(uint8_t ch) {
+    uint v = ch - 1;
+    owner[v] = nullptr;
+    releasing |= (1u << v);
+  }
+  // hand back the voices whose release has finished
+  void reclaim() {
+    uint32_t r = releasing;
+    while (r) {
+      uint v = __builtin_ctz(r);
+      r &= r - 1;
+      if (synth.env[v].is_silent()) {
+        releasing &= ~(1u << v);
+        inUse &= ~(1u << v);
+        freeStack[freeCount++] = v;
+        pluckPool.release(v);
+      }
+    }
+  }
+};
+voice_alloc_obj synthVoices;
+int synthPolyphonyInUse = 0;   // see synth_set_polyphony()
+
+// run this every loop. frees the voices that have finished their release.
+void synth_reclaim_voices() {
+  synthVoices.reclaim();
+}
+
 void trySynthNoteOn(music_key_t& h) {
   if (playbackMode != SYNTH_OFF) {
     if (playbackMode == SYNTH_POLY) {
       // operate independently of MIDI
-      if (synth.open_queue.empty()) {
+      synthVoices.reclaim();
+      h.synthCh = synthVoices.allocate(&h, synthStealPolicy, synthRetrigger);
+      if (h.synthCh && !synth.note_on(h.frequency, h.synthCh, h.velocity)) {
+        sendToLog("no room for a string that long in the pluck pool, so did not add one");
+        synth.note_off(h.synthCh);    // it may have been stolen while sounding, so let it go silent
+        synthVoices.release(h.synthCh);
+        ++synthVoices.dropped;
+        h.synthCh = 0;
+      } else if (!h.synthCh) {
         sendToLog("synth channels all firing, so did not add one");
-      } else {
-        h.synthCh = pop_and_get(synth.open_queue);
-        synth.setFreq(h.frequency, h.synthCh);
       }
     } else {    
       // operate in lockstep with MIDI
       if (h.MIDIch) {
-        replaceMonoSynthWith(h.index);
+        bool first = (heldNotes.count == 0);
+        if (!heldNotes.add(&h)) {
+          sendToLog("too many held notes, so did not add one");
+        } else if (playbackMode == SYNTH_MONO) {
+          playMonoSynth();
+        } else if (first) {
+          arpeggiator.restart = true;   // start the arpeggio on this key, now
+        }
       }
     }
   }
 }
 void trySynthNoteOff(music_key_t& h) {
   if (playbackMode && (playbackMode != SYNTH_POLY)) {
-    if (arpeggiatingNow == h.pixel) {
-      replaceMonoSynthWith(findNextHeldNote());
+    heldNotes.remove(&h);
+    if (playbackMode == SYNTH_MONO) {
+      playMonoSynth();
     }
   }
   if (playbackMode == SYNTH_POLY) {
     if (h.synthCh) {
-      synth.setFreq(0, h.synthCh);
-      synth.open_queue.push_back(h.synthCh);
+      // the voice is free again once it is silent
+      synth.note_off(h.synthCh);
+      synthVoices.release(h.synthCh);
       h.synthCh = 0;
     }
   }
@@ -322,36 +1500,190 @@ void trySynthNoteOff(music_key_t& h) {
 
 void synth_reset() {
   // i don't think there's anything else to do to initialize the synth in this version
-  while (!synth.open_queue.empty()) {
-    synth.open_queue.pop_front();
-  }
   for (auto& i : synth.channel) {
     i.increment = 0;
     i.counter = 0;
   }
+  for (auto& e : synth.env) {
+    e.note_off();
+  }
   for (auto& h : hexBoard.keys) {
     h.synthCh = 0;
   }
-  if (playbackMode == SYNTH_POLY) {
-    for (uint8_t i = 0; i < POLYPHONY_LIMIT; i++) {
-      synth.open_queue.push_back(i + 1);
-    }
+  heldNotes.clear();
+  monoKey = nullptr;
+  critical_section_enter_blocking(&pluckPool.lock);
+  for (auto& p : synth.pluck) {
+    p.nextLine = 0;
   }
+  pluckPool.clear();
+  critical_section_exit(&pluckPool.lock);
+  synthVoices.reset(playbackMode == SYNTH_POLY ? synthPolyphonyInUse : 0);
   audioOut.set_pin(piezoPin,     audioD & AUDIO_PIEZO);
   audioOut.set_pin(audioJackPin, audioD & AUDIO_AJACK);
   sendToLog("synth is reset.");
 }
 
-void synth_setup() {
-  synth.init();
-  synth_reset();
+
+/*
+  Measures what a synth sample costs in processor cycles,
+  on a copy of the synth so the live notes are left alone.
+  The host benchmarks in test/ compare this with the one
+  sample at a time next_sample().
+*/
+const uint synthBenchSamples = 1024;
+void bench_synth(synth_obj& bench, uint voices) {
+  bench = synth;
+  bench.init();
+  for (uint i = 0; i < voices; i++) {
+    bench.channel[i].set_frequency(110.0 * (i + 2));
+    bench.env[i].note_on();
+  }
+}
+synth_obj benchSynth;    // not on the stack: core 1's is too small for a synth
+// cycles per sample for render() with this many voices sounding
+uint32_t synth_render_cycles(uint voices, bool useInterp = SYNTH_USES_INTERP, uint8_t wave = currWave) {
+  synth_obj& bench = benchSynth;
+  bench_synth(bench, voices);
+  bench.useInterp = useInterp;
+  audio_sample out[SYNTH_BLOCK_SIZE];
+  uint32_t start = rp2040.getCycleCount();
+  for (uint s = 0; s < synthBenchSamples; s += SYNTH_BLOCK_SIZE) {
+    bench.render(out, SYNTH_BLOCK_SIZE, wave);
+  }
+  return (rp2040.getCycleCount() - start) / synthBenchSamples;
+}
+/*
+  The output filters run for every sample, per pin, so they
+  come off the synth's budget. This measures both pins on
+  fresh copies of their filters. They should take no more
+  than AUDIO_FILTER_BUDGET_PERCENT of a sample period; the
+  host benchmark in test/ fails if they do.
+*/
+#define AUDIO_FILTER_BUDGET_PERCENT 10
+uint32_t audio_filter_cycles() {
+  audio_output_t piezo = audioOut.make_output(piezoPin);
+  audio_output_t jack = audioOut.make_output(audioJackPin);
+  uint32_t sum = 0;
+  uint32_t start = rp2040.getCycleCount();
+  for (uint s = 0; s < synthBenchSamples; s++) {
+    audio_sample x = 32768 + ((s & 64) ? 8192 : -8192);
+    sum += piezo.level(x) + jack.level(x);
+  }
+  uint32_t cycles = (rp2040.getCycleCount() - start) / synthBenchSamples;
+  static volatile uint32_t keep;
+  keep = sum;    // so the loop is not optimised away
+  return cycles;
 }
+/*
+  FM should play 8 voices inside the synth's budget at the
+  current sample rate; the host benchmark in test/ fails
+  if it does not.
+*/
+#define FM_BUDGET_VOICES 8
 
-void synth_arpeggiate() {
-  if (playbackMode == SYNTH_ARPEGGIO) {
-    if (runTime - arpeggiateTime > arpeggiateLength) {
-      arpeggiateTime = runTime;
-      replaceMonoSynthWith(findNextHeldNote());
+/*
+  The render cost of each waveform, at one voice and at
+  POLYPHONY_LIMIT voices, and the cost of the output
+  filters, in cycles per sample. They are measured once,
+  on core 1 where the synth runs, at boot before the audio
+  starts, and logged (the table waveforms with and without
+  the interpolator). The cost grows about in a straight
+  line with the voices, so that is all the menu needs.
+*/
+struct synth_cost_t {
+  uint32_t one = 0;
+  uint32_t full = 0;
+};
+synth_cost_t synthCost[WAVEFORM_TRIANGLE + 1];
+uint32_t synthFilterCost = 0;
+// core 1, from setup1()
+void synth_measure_costs() {
+  synthFilterCost = audio_filter_cycles();
+  sendToLog("synth cost: output filters " + std::to_string(synthFilterCost) + " cyc/smp");
+  for (uint w = 0; w <= WAVEFORM_TRIANGLE; w++) {
+    synthCost[w].one = synth_render_cycles(1, SYNTH_USES_INTERP, w);
+    synthCost[w].full = synth_render_cycles(POLYPHONY_LIMIT, SYNTH_USES_INTERP, w);
+    str line = "synth cost: wave " + std::to_string(w) + ", 1 voice " + std::to_string(synthCost[w].one) +
+      ", " + std::to_string(POLYPHONY_LIMIT) + " voices " + std::to_string(synthCost[w].full) + " cyc/smp";
+    if (SYNTH_USES_INTERP && (w <= WAVEFORM_USER)) {
+      line += ", without interp " + std::to_string(synth_render_cycles(POLYPHONY_LIMIT, false, w));
     }
+    sendToLog(line);
+  }
+}
+// cycles per sample for this many voices of the current waveform
+uint32_t synth_cost(uint voices) {
+  const synth_cost_t& c = synthCost[std::min<uint>(currWave, WAVEFORM_TRIANGLE)];
+  int32_t perVoice = ((int32_t)c.full - (int32_t)c.one) / (POLYPHONY_LIMIT - 1);
+  return std::max<int32_t>((int32_t)c.one + perVoice * ((int32_t)voices - 1), 0);
+}
+/*
+  Sets the poly synth to the number of voices chosen in the
+  menu, or to as many as there is time for if that is fewer.
+  The cost depends on the waveform, so this is run again
+  when that changes. The output filters' share comes off
+  the top.
+*/
+void synth_set_polyphony() {
+  uint32_t budget = (rp2040.f_cpu() / audioOut.get_sample_rate()) * SYNTH_CPU_BUDGET_PERCENT / 100;
+  budget -= std::min(budget, synthFilterCost);
+  synthPolyphonyInUse = constrain(synthPolyphony, 1, POLYPHONY_LIMIT);
+  while ((synthPolyphonyInUse > 1) && (synth_cost(synthPolyphonyInUse) > budget)) {
+    --synthPolyphonyInUse;
+  }
+  sendToLog("synth polyphony set to " + std::to_string(synthPolyphonyInUse) + " voices");
+  synth_reset();
+}
+
+void synth_set_arpeggio() {
+  arpeggiator.stepSamples = std::max<uint32_t>((uint64_t)arpStep_mS * audioOut.get_sample_rate() / 1000, 1);
+  arpeggiator.gateSamples = std::max<uint32_t>(arpeggiator.stepSamples * ARPEGGIO_GATE_PERCENT / 100, 1);
+}
+
+void synth_set_effects() {
+  uint rate = audioOut.get_sample_rate();
+  bool delayOn = effectsMode & EFFECTS_DELAY;
+  bool chorusOn = effectsMode & EFFECTS_CHORUS;
+  uint32_t longest = (EFFECTS_BUFFER_SAMPLES - 2) << 16;
+  effects.delayTargetQ16 = std::min<uint32_t>((uint64_t)delayTime_mS * rate * 65536 / 1000, longest);
+  effects.feedback = (delayOn ? delayFeedback * 32767 / 100 : 0);
+  effects.delayLevel = (delayOn ? delayMix * 32767 / 100 : 0);
+  effects.chorusLevel = (chorusOn ? chorusMix * 32767 / 100 : 0);
+  if (effectsMode && !effects.enabled) {
+    effects.delayQ16 = effects.delayTargetQ16;
+    effects.changed = true;     // start from a clean buffer
   }
-}
\ No newline at end of file
+  effects.enabled = effectsMode;
+}
+
+int wavetableBytes = 0;
+void synth_setup() {
+  synth.init();
+  uint8_t userWave[256];
+  File f = LittleFS.open("/wave.bin", "r");
+  if (f && (f.size() == sizeof(userWave))) {
+    f.read(userWave, sizeof(userWave));
+    sendToLog("user wavetable loaded");
+  } else {
+    memcpy(userWave, sine, sizeof(userWave));
+  }
+  if (f) {
+    f.close();
+  }
+  pitch_tables_setup();
+  memcpy(sineTable, sine, 256);
+  sineTable[256] = sine[0];
+  stringsTable.build(strings);
+  clarinetTable.build(clarinet);
+  userTable.build(userWave);
+  wavetableBytes = sizeof(sineTable) + sizeof(stringsTable) + sizeof(clarinetTable) + sizeof(userTable);
+  sendToLog("wavetables use " + std::to_string(wavetableBytes) + " bytes");
+  synth_set_envelope();
+  synth_set_arpeggio();
+  effects.setup(audioOut.get_sample_rate());
+  synth_set_effects();
+  heldNotes.init();
+  pluckPool.init();
+  synth.live = true;
+}
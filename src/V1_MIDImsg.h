@@ -163,15 +163,15 @@ void tryMIDInoteOn(music_key_t& h) {
       }
     }
     if (h.MIDIch) {
-      if(midiD&MIDID_USB)UMIDI.sendNoteOn(h.note, velWheel.curValue, h.MIDIch); // ch 1-16
-      if(midiD&MIDID_SER)SMIDI.sendNoteOn(h.note, velWheel.curValue, h.MIDIch); // ch 1-16
+      if(midiD&MIDID_USB)UMIDI.sendNoteOn(h.note, h.velocity, h.MIDIch); // ch 1-16
+      if(midiD&MIDID_SER)SMIDI.sendNoteOn(h.note, h.velocity, h.MIDIch); // ch 1-16
 
       if(midiD&MIDID_USB)UMIDI.sendPitchBend(h.bend, h.MIDIch); // ch 1-16
       if(midiD&MIDID_SER)SMIDI.sendPitchBend(h.bend, h.MIDIch); // ch 1-16
       sendToLog(
         "sent MIDI noteOn: " + std::to_string(h.note) +
         " pb "  + std::to_string(h.bend) +
-        " vel " + std::to_string(velWheel.curValue) +
+        " vel " + std::to_string(h.velocity) +
         " ch "  + std::to_string(h.MIDIch)
       );
     } 
@@ -194,6 +194,23 @@ void tryMIDInoteOff(music_key_t& h) {
       MPEchQueue.push_back(h.MIDIch);
     }
     h.MIDIch = 0;
+    h.pressure = 0;
+  }
+}
+
+// when every note has its own MPE channel, channel pressure acts
+// as per-note aftertouch. otherwise notes can share a channel, so
+// polyphonic key pressure is sent, which names the note.
+void tryMIDIpressure(music_key_t& h, uint8_t pressure) {
+  if (h.MIDIch) {
+    if (MPEpitchBendsNeeded > 15) {
+      if(midiD&MIDID_USB)UMIDI.sendAfterTouch(pressure, h.MIDIch);
+      if(midiD&MIDID_SER)SMIDI.sendAfterTouch(pressure, h.MIDIch);
+    } else {
+      if(midiD&MIDID_USB)UMIDI.sendAfterTouch(h.note, pressure, h.MIDIch);
+      if(midiD&MIDID_SER)SMIDI.sendAfterTouch(h.note, pressure, h.MIDIch);
+    }
+    h.pressure = pressure;
   }
 }
 
@@ -26,11 +26,51 @@ uint8_t playbackMode = SYNTH_OFF;
 #define WAVEFORM_SINE 0
 #define WAVEFORM_STRINGS 1
 #define WAVEFORM_CLARINET 2
+#define WAVEFORM_USER 3
+#define WAVEFORM_FM 4
+#define WAVEFORM_PLUCK 5
 #define WAVEFORM_HYBRID 7
 #define WAVEFORM_SQUARE 8
 #define WAVEFORM_SAW 9
 #define WAVEFORM_TRIANGLE 10 
 uint8_t currWave = WAVEFORM_HYBRID;
+int fmRatio = 1;    // FM modulator frequency, as a multiple of the note
+int fmIndex = 2;    // FM modulation index in radians, before the mod wheel
+
+// synth envelope. times are from silent to full volume (or back)
+int envAttack_mS = 5;
+int envDecay_mS = 300;
+int envSustain = 96;     // 0..127
+int envRelease_mS = 150;
+
+// poly synth voices, and what to do when they are all in use
+#define STEAL_OFF 0
+#define STEAL_OLDEST 1
+#define STEAL_QUIETEST 2
+int synthPolyphony = 8;
+uint8_t synthStealPolicy = STEAL_OLDEST;
+uint8_t synthRetrigger = 1;   // a key played again takes back its own releasing voice
+
+// arpeggiator
+#define ARP_UP 0
+#define ARP_DOWN 1
+#define ARP_UP_DOWN 2
+#define ARP_RANDOM 3
+#define ARP_AS_PLAYED 4
+uint8_t arpOrder = ARP_UP;
+int arpOctaves = 1;
+int arpStep_mS = 66;     // approx a 1/32 note at 114 BPM
+
+// effects on the synth output
+#define EFFECTS_OFF 0
+#define EFFECTS_DELAY 1
+#define EFFECTS_CHORUS 2
+#define EFFECTS_BOTH 3
+uint8_t effectsMode = EFFECTS_OFF;
+int delayTime_mS = 250;
+int delayFeedback = 35;  // percent
+int delayMix = 30;       // percent
+int chorusMix = 50;      // percent
 
 #define RAINBOW_MODE 0
 #define TIERED_COLOR_MODE 1
@@ -79,4 +79,36 @@ void presets_littleFS_setup() {
   } else {
     sendToLog("LittleFS mounted OK");
   }
-}
\ No newline at end of file
+}
+
+/*
+  Analog key calibration (rest and bottom readings
+  of each key) is kept in its own file, so it
+  survives a firmware update or a change of preset.
+*/
+const char* key_calibration_file = "/keycal.bin";
+void presets_save_key_calibration() {
+  File f = LittleFS.open(key_calibration_file, "w");
+  if (!f) {
+    sendToLog("could not write the key calibration file");
+    return;
+  }
+  f.write((const uint8_t*)pinGrid.analog().calibration, sizeof(pinGrid.analog().calibration));
+  f.close();
+  sendToLog("key calibration saved");
+}
+void presets_load_key_calibration() {
+  File f = LittleFS.open(key_calibration_file, "r");
+  if (!f) {
+    sendToLog("no key calibration file, using defaults");
+    return;
+  }
+  if (f.size() == sizeof(pinGrid.analog().calibration)) {
+    f.read((uint8_t*)pinGrid.analog().calibration, sizeof(pinGrid.analog().calibration));
+    pinGrid.analog().apply_calibration();
+    sendToLog("key calibration loaded");
+  } else {
+    sendToLog("key calibration file is the wrong size, ignored");
+  }
+  f.close();
+}
@@ -220,6 +220,77 @@ const uint keyboard_pin_reset_period_in_uS =     16;
 const uint target_audio_sample_rate_in_Hz  = 31'250;
 const uint target_LED_frame_rate_in_Hz     =     30;
 
+// Audio output mode. With DMA, blocks of samples are streamed
+// into the PWM pins by a DMA channel, paced by a DMA timer at the
+// sample rate, and the synth refills one half of a double buffer
+// at a time. Without DMA, a timer task copies one sample at a time.
+const bool audio_output_uses_DMA            = true;
+const uint audio_DMA_block_size             =     64; // samples per half-buffer
+
+// PWM output resolution, 8 to 11 bits. see hwAudio.h for the
+// trade-off with the carrier frequency. noise shaping carries
+// the bits below that resolution over from sample to sample.
+const uint audio_PWM_bits                   =     10;
+const bool audio_PWM_noise_shaping          =   true;
+
+// Output filters (see hwAudio.h). The piezo is cut around its
+// resonance and below what it can play; the jack only loses DC.
+// The piezo values follow the old equal-loudness guess of -6 dB
+// at 3250 Hz, back to flat by 1500 and 5000 Hz.
+const uint piezo_low_cut_Hz                 =    200;
+const uint piezo_resonance_Hz               =  3'250;
+const int  piezo_resonance_gain_in_dB       =     -6;
+const uint piezo_resonance_width_in_Hz      =  3'500;
+const uint audio_jack_DC_block_Hz           =     10;
+
+// How the key matrix is scanned.
+//   key_scan_by_pin: the keyboard task reads one mux / column
+//     position per tick (160 ticks per scan).
+//   key_scan_by_PIO: a PIO state machine steps the mux address and
+//     samples every column pin at once, and DMA collects the results.
+//     no processor time is spent per key. needs the column pins to be
+//     consecutive GPIOs, and the mux pins to fill a block of
+//     consecutive GPIOs (in any order).
+//   key_scan_parallel: the keyboard task sets the mux address and reads
+//     every column pin at once (16 ticks per scan). needs the column
+//     pins to be consecutive GPIOs.
+enum {
+  key_scan_by_pin = 0,
+  key_scan_by_PIO = 1,
+  key_scan_parallel = 2,
+};
+const uint keyboard_scan_mode               = key_scan_by_PIO;
+const uint keyboard_mux_settle_in_uS        =     16; // wait after changing the mux address
+const uint key_event_queue_size             =    256; // key presses / releases in flight to core 0, power of two
+// A key must read the same for this long before a press or a release
+// counts. Presses are kept short for latency; releases are longer to
+// ride out worn switches. Rounded up to whole scans, at most 16 scans.
+const uint key_press_debounce_in_uS         =    500;
+const uint key_release_debounce_in_uS       =   3000;
+
+// Analog (hall effect) keys. Only used if the keys are read with
+// analogRead, which needs an analog mux in front of an ADC pin
+// (GPIO 26..29) -- the v1.1/v1.2 column pins are digital only.
+// Travel is measured in 1/1024ths of the calibrated key stroke.
+// Timing starts when a key passes the "arm" point, the note starts
+// at the "press" point, and the time between the two sets the velocity.
+// The note ends when the key comes back above the "release" point.
+// Travel beyond the press point is sent as pressure (aftertouch).
+const bool keys_are_analog                  =  false;
+const uint analog_key_arm_travel            =    200;
+const uint analog_key_press_travel          =    700;
+const uint analog_key_release_travel        =    500;
+const uint analog_velocity_fastest_in_uS    =   2000; // this stroke time or faster = velocity 127
+const uint analog_pressure_min_change       =      2; // ignore smaller pressure changes
+const uint analog_reread_every              =      4; // regular scan steps per extra read of an active key;
+                                                      // so held keys slow the full scan by at most 1/4
+
+// Worst-case run time of the lower-priority background tasks.
+// The task manager holds a task back for a tick rather than
+// let it make the audio sample late.
+const uint rotary_task_budget_in_uS        =      4;
+const uint keyboard_task_budget_in_uS      =      6;
+
 /*
   Note names and palette arrays are allocated in memory
   at runtime. Their usable size is based on the number
@@ -10,6 +10,7 @@
 #include "hwAudio.h"
 
 #include "hardware/irq.h"       // library of code to let you interrupt code execution to run something of higher priority
+#include <atomic>
 
 
 constexpr uint target_audio_sample_halfperiod_in_uS = 500'000 / target_audio_sample_rate_in_Hz;
@@ -19,44 +20,72 @@ constexpr uint hardware_tick_period_in_uS =
 constexpr uint actual_audio_sample_period_in_uS = 2 * hardware_tick_period_in_uS;
 constexpr uint actual_audio_sample_rate_in_Hz  = 1'000'000 / actual_audio_sample_period_in_uS;
 
-// this worked on Nov 7 2024
-// tested on binji.github.io/wasm-clang
-
 // task manager takes a list of repeat periods and callback functions
 // these should run in the background
 // set an alarm to run the "on_irq" boolean every "tick" microseconds.
 // load in the background functions you want using the "bind" language.
+//
+// each task keeps the time of its own next deadline. on every tick, all
+// tasks whose deadline has arrived are run, in the order they were added
+// (first added = highest priority). a task may also be given a budget,
+// i.e. how many microseconds it needs to run. a task is deferred to the
+// next tick if running it now would push a higher-priority task past its
+// upcoming deadline. if a task starts so late that one or more whole
+// periods went by, those periods are counted as missed deadlines.
+// this way the audio task keeps its period and the lower-priority tasks
+// slow down in a measurable way instead of silently.
 
 static void on_irq();
 
 class task_mgr_obj {
   private:
     struct task_obj {
-      uint counter = 0;
       uint period;
+      uint budget = 0;              // 0 = no budget, always run when due
+      uint32_t next_deadline = 0;
+      task_stats_t stats;
       func exec_on_trigger;
       void set_period(uint arg_period) {
         period = arg_period;
       }
+      void set_budget(uint arg_budget) {
+        budget = arg_budget;
+      }
       void set_trigger(func arg_func) {
         exec_on_trigger = arg_func;
       }
-      void increment(uint add_uS) {
-        counter += add_uS;
-      }
       void execute() {
         exec_on_trigger();
       }
-      bool triggered() {
-        if (counter >= period) {
-          counter = counter % period;
-          return true;
+      bool triggered(uint32_t now) {
+        return time_reached(now, next_deadline);
+      }
+      void advance(uint32_t started) {
+        next_deadline += period;
+        if (time_reached(started, next_deadline)) {
+          uint skipped = (started - next_deadline) / period + 1;
+          stats.missed += skipped;
+          next_deadline += skipped * period;
         }
-        return false;
       }
     };
     uint tick_uS = 0;
     uint8_t alarm_ID = 0;
+    uint32_t next_alarm = 0;
+    uint late_ticks = 0;
+    // the stats are written by the interrupt on core 1 and read from
+    // core 0. the version is odd while the interrupt is writing, so a
+    // reader can tell that its copy was torn and take it again; a reset
+    // is only asked for, and done by the interrupt itself.
+    std::atomic<uint32_t> stats_version{0};
+    volatile bool reset_requested = false;
+    void reset_now(uint32_t now) {
+      for (auto& t : task_list) {
+        t.stats.reset(now);
+      }
+      late_ticks = 0;
+      reset_requested = false;
+    }
     public:
       void set_tick_length(uint arg_uS) {
         tick_uS = arg_uS;
@@ -65,24 +94,103 @@ class task_mgr_obj {
       uint get_tick_uS() {
         return tick_uS;
       }
-      void add_task(uint arg_repeat_uS, func arg_on_trigger) {
+      uint add_task(uint arg_repeat_uS, func arg_on_trigger, uint arg_budget_uS = 0) {
         task_obj new_task;
         new_task.set_period(arg_repeat_uS);
         new_task.set_trigger(arg_on_trigger);
+        new_task.set_budget(arg_budget_uS);
         task_list.emplace_back(new_task);
+        return task_list.size() - 1;
+      }
+      void run_due_tasks() {
+        // "guard" is the earliest upcoming deadline of the tasks
+        // already looked at, i.e. those with a higher priority.
+        uint32_t now = timer_hw->timerawl;
+        uint32_t guard = now + tick_uS;
+        uint32_t version = stats_version.load(std::memory_order_relaxed);
+        stats_version.store(version + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        if (reset_requested) {
+          reset_now(now);
+        }
+        for (auto& t : task_list) {
+          now = timer_hw->timerawl;
+          if (t.triggered(now)) {
+            if (t.budget && !time_reached(guard, now + t.budget)) {
+              ++t.stats.deferred;
+              continue;
+            }
+            t.execute();
+            t.stats.record(timer_hw->timerawl - now, now - t.next_deadline);
+            t.advance(now);
+          }
+          if (time_reached(guard, t.next_deadline)) {
+            guard = t.next_deadline;
+          }
+        }
+        stats_version.store(version + 2, std::memory_order_release);
       }
       void set_timer() {
-        timer_hw->alarm[alarm_ID] = getTheCurrentTime() + tick_uS;
+        // step the alarm by exactly one tick so the tick does not drift.
+        // if the tasks overran the tick, skip ahead and count it.
+        // (the alarm only fires on an exact match, so it must never be
+        // set to a time that has already passed.)
+        next_alarm += tick_uS;
+        uint32_t now = timer_hw->timerawl;
+        if (time_reached(now + 2, next_alarm)) {
+          ++late_ticks;
+          next_alarm = now + tick_uS;
+        }
+        timer_hw->alarm[alarm_ID] = next_alarm;
       }
       void begin() {
+        uint32_t now = timer_hw->timerawl;
+        for (auto& t : task_list) {
+          t.next_deadline = now + t.period;
+          t.stats.reset(now);
+        }
+        next_alarm = now;
         hw_set_bits(&timer_hw->inte, 1u << alarm_ID);  // initialize the timer
         irq_set_exclusive_handler(alarm_ID, on_irq);     // function to run every interrupt
         irq_set_enabled(alarm_ID, true);               // ENGAGE!
         set_timer();
       }
-      void repeat_timer() {
+      void acknowledge() {
         hw_clear_bits(&timer_hw->intr, 1u << alarm_ID);
-        set_timer();
+      }
+      uint task_count() {
+        return task_list.size();
+      }
+      // a copy, taken again if the interrupt wrote to it meanwhile,
+      // so the caller on the other core gets one consistent set
+      task_stats_t get_stats(uint task_ID) {
+        task_stats_t copy;
+        uint32_t before;
+        uint32_t after;
+        do {
+          before = stats_version.load(std::memory_order_acquire);
+          copy = task_list[task_ID].stats;
+          std::atomic_thread_fence(std::memory_order_acquire);
+          after = stats_version.load(std::memory_order_relaxed);
+        } while ((before & 1) || (before != after));
+        return copy;
+      }
+      uint get_missed(uint task_ID) {
+        return task_list[task_ID].stats.missed;
+      }
+      uint get_deferred(uint task_ID) {
+        return task_list[task_ID].stats.deferred;
+      }
+      uint get_late_ticks() {
+        return late_ticks;
+      }
+      // asks the interrupt to reset the stats, and waits a few ticks for it
+      void reset_stats() {
+        reset_requested = true;
+        uint32_t start = timer_hw->timerawl;
+        while (reset_requested && !time_reached(timer_hw->timerawl, start + 4 * tick_uS)) {
+          tight_loop_contents();
+        }
       }
 };
 
@@ -91,17 +199,9 @@ task_mgr_obj task_mgr;
 
 // global routine, required by RP2040 interrupt process
 static void on_irq() {
-  task_mgr.repeat_timer();
-  uint t = task_mgr.get_tick_uS();
-  for (auto& i : task_mgr.task_list) {
-    i.increment(t);
-  }
-  for (auto& i : task_mgr.task_list) {
-    if (i.triggered()) {
-        i.execute();
-        break;
-    }
-  }
+  task_mgr.acknowledge();
+  task_mgr.run_due_tasks();
+  task_mgr.set_timer();   // after the tasks run, so an overrun tick is caught
 }
 
 // global, call this on setup() i.e. the 1st core
@@ -109,23 +209,44 @@ void hardware_setup() {
   // note that the audio pins can be set by the user, and that routine can live outside
   // of the setup. in other words, it is safe to run audioOut in the background even
   // if there are no audio outputs selected.
-  audioOut.setup(actual_audio_sample_rate_in_Hz);
+  audioOut.setup(actual_audio_sample_rate_in_Hz, audio_output_uses_DMA);
   //  rotary should define a pin A and B. pin C is the center click button if it exists
   rotary.setup(rotaryPinA,rotaryPinB,rotaryPinC);
   //  first T/F: are the column pins analog?
   //  second T/F: iterate thru the multiplex pins before the column pins?
-  pinGrid.setup(colPins, false, muxPins, true);
+  //  last: scan by pin or by PIO state machine (see config.h)
+  pinGrid.setup(colPins, keys_are_analog, muxPins, true, keyboard_scan_mode);
 }
 
+// which entry in the task list each background process is.
+// these are looked up by the performance page of the menu.
+// N_A means that process is not run by the task manager.
+int audio_task_ID = N_A;
+int rotary_task_ID = N_A;
+int keyboard_task_ID = N_A;
+
 // global, call this on setup1() i.e. the 2nd core
 void hardware_start_background_process() {
     task_mgr.set_tick_length(hardware_tick_period_in_uS);
     // audio sample update - highest priority (stable period needed)
-    task_mgr.add_task(actual_audio_sample_period_in_uS, std::bind(&audioOut_obj::poll, &audioOut));
+    // in DMA mode the samples are streamed without a timer task.
+    if (audio_output_uses_DMA) {
+      audioOut.begin_DMA();
+    } else {
+      audio_task_ID    = task_mgr.add_task(actual_audio_sample_period_in_uS, std::bind(&audioOut_obj::poll, &audioOut));
+    }
     // rotary knob - 2nd highest priority (input drop risk)
-    task_mgr.add_task(rotary_pin_fire_period_in_uS,     std::bind(&rotary_obj::poll,   &rotary));
+    rotary_task_ID     = task_mgr.add_task(rotary_pin_fire_period_in_uS,     std::bind(&rotary_obj::poll,   &rotary),   rotary_task_budget_in_uS);
     // keyboard - lowest priority (timing requirements are loose)
-    task_mgr.add_task(keyboard_pin_reset_period_in_uS,  std::bind(&pinGrid_obj::poll,  &pinGrid));
+    // in PIO mode the matrix is scanned without a timer task.
+    if (pinGrid.scan_mode() == key_scan_by_PIO) {
+      pinGrid.begin_PIO();
+    } else {
+      // a parallel scan only waits for the mux to settle, not for a pull-up to charge
+      uint keyboard_period = (pinGrid.scan_mode() == key_scan_parallel
+        ? keyboard_mux_settle_in_uS : keyboard_pin_reset_period_in_uS);
+      keyboard_task_ID = task_mgr.add_task(keyboard_period,  std::bind(&pinGrid_obj::poll,  &pinGrid),  keyboard_task_budget_in_uS);
+    }
     // start receiving input and processing audio output
     task_mgr.begin();
 }
\ No newline at end of file
@@ -3,134 +3,518 @@
 #include "utils.h"
 #include <Arduino.h>
 #include <Wire.h>
+#include "config.h"
+#include "timing.h"
 #include "hardware/pwm.h"       // library of code to access the processor's built in pulse wave modulation features
+#include "hardware/dma.h"       // library of code to move data to the PWM without using the processor
+#include "hardware/clocks.h"    // to work out the DMA pacing from the system clock
+#include "hardware/irq.h"
+#include "hardware/sync.h"      // to hold off the audio task while the outputs change
+#include <atomic>
 
+// samples are 16-bit unsigned, silence = 32768.
+// the audio object reduces them to the PWM resolution.
+using audio_sample = uint16_t;
+
+/*
+  Single-producer / single-consumer ring buffer of audio samples.
+  The synth on core 1 (loop1) is the only writer and the audio
+  task in the timer interrupt is the only reader. Each side only
+  ever moves its own index -- the writer owns "head", the reader
+  owns "tail" -- so no lock is needed, and the other side's index
+  is read with acquire / published with release ordering.
+  The indices count up freely and are masked into the buffer,
+  which is why the capacity is a power of two. head - tail is
+  the number of samples waiting, even after the indices wrap.
+  The underrun / overrun counters are also single-writer, so
+  they are plain volatile counters, in units of samples. They are
+  never zeroed from outside: reset_counts() only remembers where
+  they stood, and the counts are reported from there.
+*/
 struct ringBuffer_obj {
-  byte_vec buffer;
-  uint indexRead;
-  uint indexWrite;
-  uint capacity;
-  uint spaceLeft;
-  void init(uint capacity) {
-    this->capacity = capacity;
-    this->spaceLeft = capacity;
-    this->indexRead = 0;
-    this->indexWrite = 0;
-    buffer.resize(capacity);
-  }
-  void write(uint8_t element) {
-    buffer[indexWrite] = element;
-    indexWrite = (indexWrite + 1) % capacity;
-    --spaceLeft;
-  }
-  uint8_t read() {
-    uint8_t element = buffer[indexRead];
-    indexRead = (indexRead + 1) % capacity;
-    ++spaceLeft;
-    return element;
+  std::vector<audio_sample> buffer;
+  uint mask = 0;
+  std::atomic<uint> head{0};       // samples ever written
+  std::atomic<uint> tail{0};       // samples ever read
+  volatile uint underruns = 0;     // samples the reader wanted but were not there
+  volatile uint overruns = 0;      // samples the writer could not fit
+  volatile uint underrunsAtReset = 0;   // set by reset_counts(), from core 0
+  volatile uint overrunsAtReset = 0;
+  void init(uint min_capacity) {
+    uint capacity = 1;
+    while (capacity < min_capacity) {
+      capacity <<= 1;
+    }
+    buffer.assign(capacity, 0);
+    mask = capacity - 1;
+    head.store(0);
+    tail.store(0);
+    underruns = 0;
+    overruns = 0;
+    reset_counts();
+  }
+  uint capacity() {
+    return mask + 1;
+  }
+  // writer side
+  uint space() {
+    return capacity() - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+  }
+  uint write_block(const audio_sample* src, uint n) {
+    uint h = head.load(std::memory_order_relaxed);
+    uint room = capacity() - (h - tail.load(std::memory_order_acquire));
+    if (n > room) {
+      overruns = overruns + (n - room);
+      n = room;
+    }
+    uint first = std::min(n, capacity() - (h & mask));   // up to the end of the buffer
+    std::copy(src, src + first, &buffer[h & mask]);
+    std::copy(src + first, src + n, &buffer[0]);          // then wrap around
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+  void write(audio_sample element) {
+    write_block(&element, 1);
+  }
+  // reader side
+  uint available() {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+  }
+  uint read_block(audio_sample* dst, uint n) {
+    uint t = tail.load(std::memory_order_relaxed);
+    uint waiting = head.load(std::memory_order_acquire) - t;
+    if (n > waiting) {
+      underruns = underruns + (n - waiting);
+      n = waiting;
+    }
+    uint first = std::min(n, capacity() - (t & mask));
+    std::copy(&buffer[t & mask], &buffer[t & mask] + first, dst);
+    std::copy(&buffer[0], &buffer[0] + (n - first), dst + first);
+    tail.store(t + n, std::memory_order_release);
+    return n;
+  }
+  bool read(audio_sample& element) {
+    return (read_block(&element, 1) == 1);
+  }
+  // counts since the last reset_counts(), safe to call from any core
+  uint underruns_since_reset() {
+    return underruns - underrunsAtReset;
+  }
+  uint overruns_since_reset() {
+    return overruns - overrunsAtReset;
+  }
+  void reset_counts() {
+    underrunsAtReset = underruns;
+    overrunsAtReset = overruns;
+  }
+};
+
+// DMA output mode:
+// the audio buffer is split in two halves. for each PWM slice in use,
+// a pair of DMA channels take turns (each chains to the other) to copy
+// one half into the slice's compare register, one sample per tick of
+// a DMA pacing timer set to the sample rate. when a channel finishes,
+// an interrupt rewinds it and flags that half as free, and the synth
+// on core 1 refills it while the other half plays.
+static void on_audio_DMA_irq();
+
+// PWM resolution:
+// the PWM counter wraps every 2^bits - 1 clocks, so each extra bit
+// halves the carrier frequency. at 8 bits the counter counts up and
+// down (phase correct) and the carrier is about 260 kHz at 133 MHz.
+// above 8 bits it only counts up, which keeps the carrier twice as
+// high (about 130 kHz at 10 bits) at the cost of the nicer edges.
+// with noise shaping, the part of each sample below the PWM
+// resolution is carried over into the next sample (first order
+// error feedback), which moves the quantisation noise up towards
+// half the sample rate, away from where quiet passages are heard.
+
+/*
+  One biquad filter section in fixed point.
+  Coefficients are 2.14 (a0 = 1), worked out in floating point
+  for the actual sample rate when the filter is designed, so
+  nothing but integer math runs per sample.
+  The sum is done in unsigned (wrapping) arithmetic: the partial
+  sums may overflow, but the total always fits, so it comes out
+  right. The bits shifted off the result are added back into
+  the next sum, so low cut-offs do not leave a DC offset.
+*/
+struct biquad_obj {
+  int32_t b0 = 1 << 14;
+  int32_t b1 = 0;
+  int32_t b2 = 0;
+  int32_t a1 = 0;
+  int32_t a2 = 0;
+  int32_t x1 = 0;
+  int32_t x2 = 0;
+  int32_t y1 = 0;
+  int32_t y2 = 0;
+  uint32_t rem = 0;
+  void set(double B0, double B1, double B2, double A0, double A1, double A2) {
+    b0 = round(16384.0 * B0 / A0);
+    b1 = round(16384.0 * B1 / A0);
+    b2 = round(16384.0 * B2 / A0);
+    a1 = round(16384.0 * A1 / A0);
+    a2 = round(16384.0 * A2 / A0);
+  }
+  // 2nd order (Butterworth) high pass
+  void high_pass(double f, double rate) {
+    double w = 2.0 * PI * f / rate;
+    double alpha = sin(w) / sqrt(2.0);
+    set((1.0 + cos(w)) / 2.0, -(1.0 + cos(w)), (1.0 + cos(w)) / 2.0,
+         1.0 + alpha, -2.0 * cos(w), 1.0 - alpha);
+  }
+  // 1st order high pass, e.g. to block DC
+  void high_pass_1st(double f, double rate) {
+    double k = tan(PI * f / rate);
+    set(1.0, -1.0, 0.0, 1.0 + k, k - 1.0, 0.0);
+  }
+  // boost or cut around f, "width" wide (in Hz)
+  void peak(double f, double dB, double width, double rate) {
+    double w = 2.0 * PI * f / rate;
+    double alpha = sin(w) * width / (2.0 * f);
+    double A = pow(10.0, dB / 40.0);
+    set(1.0 + alpha * A, -2.0 * cos(w), 1.0 - alpha * A,
+        1.0 + alpha / A, -2.0 * cos(w), 1.0 - alpha / A);
+  }
+  // x and the result are signed 16-bit
+  int32_t process(int32_t x) {
+    uint32_t acc = rem
+      + (uint32_t)(b0 * x) + (uint32_t)(b1 * x1) + (uint32_t)(b2 * x2)
+      - (uint32_t)(a1 * y1) - (uint32_t)(a2 * y2);
+    rem = acc & 0x3FFF;
+    int32_t y = constrain((int32_t)acc >> 14, -32768, 32767);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    return y;
+  }
+};
+
+/*
+  Each output pin has its own filter and its own noise shaping.
+  The piezo is cut around its resonance, and below the lowest
+  notes it can play, to leave more room for the rest; the audio
+  jack only has its DC taken out. See config.h for the values.
+*/
+#define AUDIO_FILTER_STAGES 2
+struct audio_output_t {
+  uint8_t pin = 0;
+  uint slice = 0;
+  uint channel = 0;           // A = 0 or B = 1 within the slice
+  uint pair = 0;              // which DMA pair, in DMA mode
+  uint stages = 0;
+  biquad_obj filter[AUDIO_FILTER_STAGES];
+  uint32_t shapeError = 0;    // below-resolution remainder of the last sample
+  static constexpr uint32_t silence = 32768 >> (16 - audio_PWM_bits);   // the PWM level of a silent sample
+  // from a 16-bit sample to a PWM level of audio_PWM_bits
+  uint32_t level(audio_sample s) {
+    int32_t x = (int32_t)s - 32768;
+    for (uint f = 0; f < stages; f++) {
+      x = filter[f].process(x);
+    }
+    uint32_t v = x + 32768;
+    const uint shift = 16 - audio_PWM_bits;
+    if (!audio_PWM_noise_shaping) {
+      return v >> shift;
+    }
+    v = std::min<uint32_t>(v + shapeError, 65535);
+    shapeError = v & ((1u << shift) - 1);
+    return v >> shift;
   }
 };
 
 class audioOut_obj {
   private:
-    byte_vec pwmPins;
+    std::atomic<uint32_t> _pinMask{0};      // the pins asked for, one bit per GPIO; written on core 0
+    byte_vec pwmPins;                       // the pins in use; core 1 only
+    std::vector<audio_output_t> _outputs;   // rebuilt from pwmPins on core 1
     ringBuffer_obj buffer;
     uint sample_rate;
+    bool _useDMA = false;
+    volatile bool _pinsChanged = false;
+    int _dmaTimer = -1;
+    audio_sample _lastSample = 32768;       // timer mode: played again if the buffer runs dry
+    struct dma_pair_t {
+      uint slice;
+      uint ch[2];
+      uint32_t buffer[2][audio_DMA_block_size];   // PWM compare values (channel B << 16 | channel A)
+    };
+    std::vector<dma_pair_t> _dmaPairs;
+    volatile bool _dmaRunning = false;       // false while _dmaPairs is being rebuilt
+    volatile bool _halfFree[2] = {false, false};
+    uint _fillHalf = 0;
+    uint _fillIndex = 0;
+    volatile uint _underruns = 0;            // in samples, like ringBuffer_obj; only the interrupt writes it
+    volatile uint _underrunsAtReset = 0;
+    task_stats_t _dmaStats;
+    uint32_t _dmaStartTime = 0;              // when the first half started playing, in uS
+    uint64_t _dmaHalvesPlayed = 0;           // since then
+    audio_output_t _piezoDesign;
+    audio_output_t _jackDesign;
+    // work out the filter coefficients for the sample rate
+    void design_filters() {
+      _piezoDesign = audio_output_t();
+      _piezoDesign.filter[0].high_pass(piezo_low_cut_Hz, sample_rate);
+      _piezoDesign.filter[1].peak(piezo_resonance_Hz, piezo_resonance_gain_in_dB,
+                                  piezo_resonance_width_in_Hz, sample_rate);
+      _piezoDesign.stages = 2;
+      _jackDesign = audio_output_t();
+      _jackDesign.filter[0].high_pass_1st(audio_jack_DC_block_Hz, sample_rate);
+      _jackDesign.stages = 1;
+    }
     void enable(uint8_t pin) {
-      auto n = std::find(pwmPins.begin(), pwmPins.end(), pin);
-      if (n == pwmPins.end()) {
-        pwmPins.emplace_back(pin);
-        gpio_set_function(pin, GPIO_FUNC_PWM);      // set that pin as PWM
-        uint8_t slice = pwm_gpio_to_slice_num(pin);
-        pwm_set_phase_correct(slice, true);           // phase correct sounds better
-        pwm_set_wrap(slice, 254);                     // 0 - 254 allows 0 - 255 level
-        pwm_set_clkdiv(slice, 1.0f);                  // run at full clock speed
-        pwm_set_gpio_level(pin, 0);        // initialize at zero to prevent whining sound
-        pwm_set_enabled(slice, true);                 // ENGAGE!
-      }
-    }
-    void disable(uint8_t pin) {
-      auto e = remove(pwmPins.begin(), pwmPins.end(), pin);
-      pwmPins.erase(e, pwmPins.end());
+      gpio_set_function(pin, GPIO_FUNC_PWM);      // set that pin as PWM
+      uint8_t slice = pwm_gpio_to_slice_num(pin);
+      pwm_set_phase_correct(slice, audio_PWM_bits <= 8);   // phase correct sounds better, if the carrier allows
+      pwm_set_wrap(slice, (1u << audio_PWM_bits) - 2);     // e.g. 0 - 254 allows 0 - 255 level
+      pwm_set_clkdiv(slice, 1.0f);                  // run at full clock speed
+      pwm_set_gpio_level(pin, 0);        // initialize at zero to prevent whining sound
+      pwm_set_enabled(slice, true);                 // ENGAGE!
+    }
+    // run on core 1, which owns pwmPins: bring it in line with the
+    // pins asked for. in timer mode the audio task reads the outputs
+    // from an interrupt on this core, so hold it off.
+    void rebuild_outputs() {
+      _pinsChanged = false;     // before reading the mask, so a later change is not missed
+      uint32_t mask = _pinMask.load(std::memory_order_acquire);
+      byte_vec pins;
+      for (uint8_t pin = 0; pin < 32; pin++) {
+        if ((mask >> pin) & 1) {
+          if (std::find(pwmPins.begin(), pwmPins.end(), pin) == pwmPins.end()) {
+            enable(pin);
+          }
+          pins.emplace_back(pin);
+        }
+      }
+      uint32_t saved = save_and_disable_interrupts();
+      pwmPins = pins;
+      _outputs.clear();
+      for (auto& pin : pwmPins) {
+        _outputs.emplace_back(make_output(pin));
+      }
+      restore_interrupts(saved);
+    }
+    void stop_DMA() {
+      uint32_t mask = 0;
+      for (auto& p : _dmaPairs) {
+        for (auto& c : p.ch) {
+          dma_channel_set_irq1_enabled(c, false);
+          mask |= (1u << c);
+        }
+      }
+      // abort both channels of a pair together, otherwise one re-triggers the other
+      dma_hw->abort = mask;
+      while (dma_hw->abort & mask) {
+        tight_loop_contents();
+      }
+      for (auto& p : _dmaPairs) {
+        for (auto& c : p.ch) {
+          dma_channel_acknowledge_irq1(c);
+          dma_channel_unclaim(c);
+        }
+      }
+      _dmaPairs.clear();
+    }
+    // run on core 1, since the channel list is shared with the interrupt.
+    // DMA_IRQ_1 stays on for the key scan; the audio channels have their
+    // own interrupt bits turned off, and the handler keeps out meanwhile.
+    void restart_DMA() {
+      _dmaRunning = false;
+      stop_DMA();
+      rebuild_outputs();
+      for (auto& o : _outputs) {
+        auto match = [&o](const dma_pair_t& p) { return p.slice == o.slice; };
+        auto found = std::find_if(_dmaPairs.begin(), _dmaPairs.end(), match);
+        o.pair = found - _dmaPairs.begin();
+        if (found == _dmaPairs.end()) {
+          dma_pair_t p;
+          p.slice = o.slice;
+          p.ch[0] = dma_claim_unused_channel(true);
+          p.ch[1] = dma_claim_unused_channel(true);
+          _dmaPairs.emplace_back(p);
+        }
+      }
+      _halfFree[0] = false;   // half 0 plays first...
+      _halfFree[1] = true;    // ...while the synth fills half 1
+      _fillHalf = 1;
+      _fillIndex = 0;
+      uint32_t startMask = 0;
+      for (auto& p : _dmaPairs) {
+        for (auto& h : p.buffer) {
+          std::fill(std::begin(h), std::end(h), (audio_output_t::silence << 16) | audio_output_t::silence);
+        }
+        for (uint h = 0; h < 2; h++) {
+          dma_channel_config c = dma_channel_get_default_config(p.ch[h]);
+          channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+          channel_config_set_read_increment(&c, true);
+          channel_config_set_write_increment(&c, false);
+          channel_config_set_dreq(&c, dma_get_timer_dreq(_dmaTimer));
+          channel_config_set_chain_to(&c, p.ch[1 - h]);
+          dma_channel_configure(p.ch[h], &c, &pwm_hw->slice[p.slice].cc, p.buffer[h], audio_DMA_block_size, false);
+          dma_channel_set_irq1_enabled(p.ch[h], true);
+        }
+        startMask |= (1u << p.ch[0]);
+      }
+      dma_start_channel_mask(startMask);   // all slices start on the same pacing tick
+      _dmaStartTime = timer_hw->timerawl;
+      _dmaHalvesPlayed = 0;
+      _dmaRunning = true;
+    }
+    uint32_t dma_divider() {
+      return clock_get_hz(clk_sys) / sample_rate;
     }
   public:
-    void setup(uint arg_sample_rate) {
+    void setup(uint arg_sample_rate, bool arg_useDMA = false) {
       sample_rate = arg_sample_rate;
+      _useDMA = arg_useDMA;
+      if (_useDMA) {
+        sample_rate = clock_get_hz(clk_sys) / dma_divider();   // the rate the DMA timer will really run at
+      }
       buffer.init(512);
+      design_filters();
     }
+    // only posts the change; core 1 picks it up in roomToWrite()
     void set_pin(uint8_t pin, bool activate) {
-      if (activate) {
-        enable(pin);
-      } else {
-        disable(pin);
+      uint32_t bit = (1u << pin);
+      uint32_t old = _pinMask.load(std::memory_order_relaxed);
+      uint32_t mask = (activate ? (old | bit) : (old & ~bit));
+      if (mask != old) {
+        _pinMask.store(mask, std::memory_order_release);
+        _pinsChanged = true;
       }
     }
-    void poll() {
-      uint8_t lvl = 0;
-      if (buffer.capacity - buffer.spaceLeft) {
-        lvl = buffer.read();
+    // a fresh output for this pin, with the filter that suits it
+    audio_output_t make_output(uint8_t pin) {
+      audio_output_t o = (pin == piezoPin ? _piezoDesign : _jackDesign);
+      o.pin = pin;
+      o.slice = pwm_gpio_to_slice_num(pin);
+      o.channel = pwm_gpio_to_channel(pin);
+      return o;
+    }
+    // call on setup1(), so that the refill interrupt runs on core 1.
+    void begin_DMA() {
+      _dmaTimer = dma_claim_unused_timer(true);
+      dma_timer_set_fraction(_dmaTimer, 1, dma_divider());
+      irq_add_shared_handler(DMA_IRQ_1, on_audio_DMA_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+      _dmaStats.reset(timer_hw->timerawl);
+      restart_DMA();
+      irq_set_enabled(DMA_IRQ_1, true);
+    }
+    // DMA_IRQ_1 is shared with the key scan, so only the calls that
+    // find one of these channels done are counted. how late the call
+    // is runs from when the half should have finished playing.
+    void service_DMA_irq() {
+      if (!_dmaRunning) {
+        return;
       }
-      for (auto& pin : pwmPins) {
-        pwm_set_gpio_level(pin, lvl);      
+      uint32_t start = timer_hw->timerawl;
+      bool halfDone = false;
+      for (auto& p : _dmaPairs) {
+        for (uint h = 0; h < 2; h++) {
+          if (dma_channel_get_irq1_status(p.ch[h])) {
+            dma_channel_acknowledge_irq1(p.ch[h]);
+            dma_channel_set_read_addr(p.ch[h], p.buffer[h], false);   // rewind for its next turn
+            if (&p == &_dmaPairs.front()) {
+              // half h has finished and the other half is now playing.
+              // if that one was never refilled, the old samples repeat.
+              if (_halfFree[1 - h]) {
+                _underruns = _underruns + audio_DMA_block_size;
+              }
+              _halfFree[h] = true;
+              ++_dmaHalvesPlayed;
+              halfDone = true;
+            }
+          }
+        }
+      }
+      if (halfDone) {
+        uint32_t due = _dmaStartTime + (uint32_t)(_dmaHalvesPlayed * audio_DMA_block_size * 1'000'000ull / sample_rate);
+        int32_t late = start - due;
+        _dmaStats.record(timer_hw->timerawl - start, std::max<int32_t>(late, 0));
+      }
+    }
+    void poll() {
+      buffer.read(_lastSample);      // if the buffer ran dry, the last sample is held
+      for (auto& o : _outputs) {
+        pwm_set_gpio_level(o.pin, o.level(_lastSample));
       }
     }
     uint roomToWrite() {
-      return buffer.spaceLeft;
+      if (_pinsChanged) {
+        if (_useDMA) {
+          restart_DMA();
+        } else {
+          rebuild_outputs();
+        }
+      }
+      if (!_useDMA) {
+        return buffer.space();
+      }
+      return (_halfFree[_fillHalf] ? audio_DMA_block_size - _fillIndex : 0);
     }
-    void write(uint8_t element) {
-      buffer.write(element);
+    void write(audio_sample element) {
+      write_block(&element, 1);
     }
-};
-audioOut_obj audioOut;
-
-/*
-  void recalculateEQ() {
-    // EQ   8    7    6    5    4    3    2    1    0
-    // dB  +4   +3   +1.5  0   -2   -4.5 -8   -14  -inf
-    // dB = 20*ln(EQ)/ln(10).
-    // NOTE this is NOT real EQ, it's adjusting the volume
-    // only based on the note frequency, not its harmonics
-    //                                       EQ  MIDI notes
-          if (_freq <     8.0) {_eq = 0;} // -inf below  0 (C -1)
-    else if (_freq <    60.0) {_eq = 8;} // +4dB 0 to 34 (Bb1)
-    else if (_freq <  1500.0) {_eq = 7;} // +3dB   to 90 (F#6)
-    else if (_freq <  2000.0) {_eq = 6;} // +1.5   to 95 (B 6)
-    else if (_freq <  2500.0) {_eq = 5;} //  0dB   to 99 (Eb7)
-    else if (_freq <  3000.0) {_eq = 4;} // -2dB  to 102 (F#7)
-    else if (_freq <  3500.0) {_eq = 3;} // -4.5  to 104 (Ab7)
-    else if (_freq <  4000.0) {_eq = 4;} // -2dB  to 107 (B 7)
-    else if (_freq <  4500.0) {_eq = 5;} //  0dB  to 109 (C#8)
-    else if (_freq <  5000.0) {_eq = 6;} // +1.5  to 111 (Eb8)
-    else if (_freq < 13290.0) {_eq = 7;} // +3dB  to 127.99 (G#9-1c)
-    else                      {_eq = 0;}
-  }
-  byte isoTwoTwentySix(float f) {
-    //
-    //  a very crude implementation of ISO 226
-    //  equal loudness curves
-    //    Hz dB  Amp ~ sqrt(10^(dB/10))
-    //    200  0  8
-    //    800 -3  6   
-    //   1500  0  8
-    //   3250 -6  4
-    //   5000  0  8
-    //
-    if ((f < 8.0) || (f > 12500.0)) {   // really crude low- and high-pass
-      return 0;
-    } else {
-      if (EQUAL_LOUDNESS_ADJUST) {
-        if ((f <= 200.0) || (f >= 5000.0)) {
-          return 8;
-        } else {
-          if (f < 1500.0) {
-            return 6 + 2 * (float)(abs(f-800) / 700);
-          } else {
-            return 4 + 4 * (float)(abs(f-3250) / 1750);
+    // write up to n samples; returns how many were taken.
+    uint write_block(const audio_sample* samples, uint n) {
+      if (!_useDMA) {
+        return buffer.write_block(samples, n);
+      }
+      uint written = 0;
+      while ((written < n) && roomToWrite()) {
+        uint chunk = std::min(n - written, roomToWrite());
+        for (auto& o : _outputs) {
+          uint32_t* dst = &_dmaPairs[o.pair].buffer[_fillHalf][_fillIndex];
+          uint shift = 16 * o.channel;
+          for (uint i = 0; i < chunk; i++) {
+            dst[i] = (dst[i] & ~(0xFFFFu << shift)) | (o.level(samples[written + i]) << shift);
           }
         }
-      } else {
-        return 8;
+        written += chunk;
+        _fillIndex += chunk;
+        if (_fillIndex == audio_DMA_block_size) {
+          _fillIndex = 0;
+          _halfFree[_fillHalf] = false;
+          _fillHalf ^= 1;
+        }
       }
+      return written;
     }
-  }
-*/
\ No newline at end of file
+    bool uses_DMA() {
+      return _useDMA;
+    }
+    uint get_sample_rate() {
+      return sample_rate;
+    }
+    // the refill interrupt, reported like a background task.
+    // a missed deadline is a half-buffer that was not refilled in time.
+    task_stats_t get_DMA_stats() {
+      task_stats_t stats = _dmaStats;
+      stats.missed = _underruns - _underrunsAtReset;
+      return stats;
+    }
+    void reset_DMA_stats() {
+      _dmaStats.reset(timer_hw->timerawl);
+      _underrunsAtReset = _underruns;
+    }
+    // samples that went out stale or silent because the synth fell behind
+    uint get_underruns() {
+      return (_useDMA ? _underruns - _underrunsAtReset : buffer.underruns_since_reset());
+    }
+    // samples the synth made that did not fit in the buffer
+    uint get_overruns() {
+      return (_useDMA ? 0 : buffer.overruns_since_reset());
+    }
+    // the counters belong to core 1, so core 0 only moves the baseline
+    void reset_buffer_counts() {
+      buffer.reset_counts();
+      _underrunsAtReset = _underruns;
+    }
+};
+audioOut_obj audioOut;
+
+static void on_audio_DMA_irq() {
+  audioOut.service_DMA_irq();
+}
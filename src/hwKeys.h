@@ -2,6 +2,242 @@
 #include "utils.h"
 #include <Arduino.h>
 #include <Wire.h>
+#include "config.h"
+#include "timing.h"
+#include "hardware/pio.h"         // PIO state machine scans the matrix
+#include "hardware/dma.h"         // and DMA collects the samples
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include <array>
+#include <atomic>
+
+// PIO scan mode:
+// a state machine runs this four-instruction loop, once per mux value.
+//   pull block             ; next mux address, fed from RAM by DMA
+//   out pins, <n> [settle] ; drive the mux pins, wait for them to settle
+//   in pins, <columns>     ; sample every column pin at once
+//   push block             ; hand the sample to DMA
+// the mux addresses are stored already re-ordered for the GPIO block,
+// so the mux pins can be wired in any order. the state machine runs
+// at 1 MHz so each delay cycle is one microsecond.
+// a second DMA channel copies one word per mux value into a scan
+// buffer. when a whole scan is in, the DMA interrupt turns it into
+// key events and starts the next scan.
+// the processor does no work per key.
+//
+// parallel scan mode:
+// the keyboard task does one mux value per tick. it reads every column
+// pin with one gpio_get_all(), then sets the next mux address with one
+// masked write. all columns keep their pull-ups on, and the task period
+// gives the mux time to settle. a full scan takes 16 ticks instead of 160.
+//
+// however the matrix is scanned, each finished scan is gathered into a
+// bitmap with one bit per key (set = pressed), bit number = linear_index.
+// it is compared with the key states last sent, and only the keys that
+// changed go into the event queue, so core 0 never reads the bitmap.
+//
+// debounce:
+// before it is compared, each scan goes through an integrator. a key
+// whose reading differs from its debounced state counts up once per
+// scan, and flips when the count reaches the press (or release) number
+// of scans; a reading that agrees again resets the count. the counts
+// are kept as a 4-bit "vertical" counter, one bitmap per counter bit,
+// so all keys are counted at once with a few word operations.
+// a count that resets before flipping is a bounce, and is added to
+// that key's chatter count.
+static void on_key_scan_DMA_irq();
+
+const uint max_key_count = 256;
+typedef std::array<uint32_t, max_key_count / 32> key_bitmap_t;
+
+// a key press or release, as seen by the scanner at the end of a scan.
+struct key_event_t {
+  uint16_t hwKey;        // linear_index of the key
+  bool     pressed;
+  time_uS  timestamp;    // when the scan that saw it finished
+  uint8_t  velocity;     // 1..127 if an analog key measured it, 0 if not
+};
+
+/*
+  Analog (hall effect) key pipeline, run by the scanner on core 1.
+  Each reading is turned into travel (0..1024) using that key's
+  calibration: the reading at rest and fully pressed. The scale is
+  worked out once, so each reading costs a multiply and a shift.
+  A key goes idle -> armed -> down -> idle as it passes the arm,
+  press and release points (see config.h). The time from arm to
+  press gives the velocity, and travel past the press point gives
+  the pressure. Armed and down keys are "active"; the scanner reads
+  those again between the regular scan steps, so strokes are timed
+  more finely than the full scan period.
+*/
+struct key_calibration_t {
+  uint16_t rest = 1023;    // reading with the key up
+  uint16_t bottom = 0;     // reading with the key all the way down
+};
+class analogKeys_obj {
+  private:
+    enum : uint8_t { key_idle, key_armed, key_down };
+    int32_t  _scale[max_key_count];      // 1024 * 1024 / (bottom - rest)
+    uint8_t  _phase[max_key_count] = {};
+    uint32_t _armedAt[max_key_count] = {};
+    uint8_t  _velocity[max_key_count] = {};
+    uint8_t  _pressure[max_key_count] = {};
+    int32_t  _pressureScale = 0;         // 127 * 65536 / (1024 - press travel)
+    bool _captureRest = false;
+    bool _captureBottom = false;
+    void set_bit(key_bitmap_t& bits, uint k, bool on) {
+      if (on) {
+        bits[k >> 5] |=  (1u << (k & 31));
+      } else {
+        bits[k >> 5] &= ~(1u << (k & 31));
+      }
+    }
+  public:
+    key_calibration_t calibration[max_key_count];
+    key_bitmap_t down = {};      // past the press point
+    key_bitmap_t active = {};    // armed or down
+    analogKeys_obj() {
+      apply_calibration();
+      _pressureScale = (127 << 16) / (1024 - analog_key_press_travel);
+    }
+    void apply_calibration() {
+      for (uint k = 0; k < max_key_count; k++) {
+        int span = (int)calibration[k].bottom - (int)calibration[k].rest;
+        _scale[k] = (span ? (1024 << 10) / span : 0);
+      }
+    }
+    // the next complete scan becomes the rest position
+    void capture_rest() {
+      _captureRest = true;
+    }
+    // while on, each key's reading farthest from rest becomes its bottom
+    void capture_bottom(bool on) {
+      if (on && !_captureBottom) {
+        for (uint k = 0; k < max_key_count; k++) {
+          calibration[k].bottom = calibration[k].rest;
+        }
+      }
+      _captureBottom = on;
+      if (!on) {
+        apply_calibration();
+      }
+    }
+    void end_of_scan() {
+      if (_captureRest) {
+        _captureRest = false;
+        apply_calibration();
+      }
+    }
+    void process(uint k, int raw, uint32_t now) {
+      key_calibration_t& cal = calibration[k];
+      if (_captureRest) {
+        cal.rest = raw;
+        return;
+      }
+      if (_captureBottom) {
+        if (abs(raw - (int)cal.rest) > abs((int)cal.bottom - (int)cal.rest)) {
+          cal.bottom = raw;
+        }
+        return;
+      }
+      int travel = constrain(((raw - (int)cal.rest) * _scale[k]) >> 10, 0, 1024);
+      switch (_phase[k]) {
+        case key_idle:
+          if (travel >= (int)analog_key_arm_travel) {
+            _phase[k] = key_armed;
+            _armedAt[k] = now;
+            set_bit(active, k, true);
+          }
+          break;
+        case key_armed:
+          if (travel >= (int)analog_key_press_travel) {
+            uint32_t stroke = std::max<uint32_t>(now - _armedAt[k], 1);
+            _velocity[k] = constrain(127 * analog_velocity_fastest_in_uS / stroke, 1u, 127u);
+            _phase[k] = key_down;
+            set_bit(down, k, true);
+          } else if (travel < (int)analog_key_arm_travel / 2) {
+            _phase[k] = key_idle;   // a partial stroke, no note
+            set_bit(active, k, false);
+          }
+          break;
+        case key_down:
+          if (travel < (int)analog_key_release_travel) {
+            _phase[k] = key_idle;
+            _pressure[k] = 0;
+            set_bit(down, k, false);
+            set_bit(active, k, false);
+          } else if (travel > (int)analog_key_press_travel) {
+            _pressure[k] = ((travel - analog_key_press_travel) * _pressureScale) >> 16;
+          } else {
+            _pressure[k] = 0;
+          }
+          break;
+      }
+    }
+    // velocity of the last press, 1..127
+    uint8_t velocity(uint k) {
+      return _velocity[k];
+    }
+    // 0..127 while down
+    uint8_t pressure(uint k) {
+      return _pressure[k];
+    }
+    // the first active key after "after", wrapping around. false if none.
+    bool next_active(uint after, uint words, uint& k) {
+      for (uint i = 1; i <= words * 32; i++) {
+        uint j = (after + i) % (words * 32);
+        uint32_t rest = active[j >> 5] >> (j & 31);
+        if (rest) {
+          k = j + __builtin_ctz(rest);
+          return true;
+        }
+        i += 31 - (j & 31);   // nothing left in this word
+      }
+      return false;
+    }
+};
+
+/*
+  Single-producer / single-consumer queue of key events, the same
+  way as the audio ring buffer: the scanner on core 1 only moves
+  "head", the interface on core 0 only moves "tail", and each reads
+  the other's index with acquire ordering. Fixed size, no allocation.
+  If the queue is full, the scanner does not count the key as sent,
+  so the change is offered again after the next scan; nothing is lost,
+  it is only late. Those retries are counted in "full".
+*/
+struct key_event_queue_obj {
+  std::array<key_event_t, key_event_queue_size> events;
+  static constexpr uint mask = key_event_queue_size - 1;
+  static_assert((key_event_queue_size & mask) == 0, "key_event_queue_size must be a power of two");
+  std::atomic<uint> head{0};       // events ever written
+  std::atomic<uint> tail{0};       // events ever read
+  volatile uint full = 0;          // events that had to wait for room
+  // writer side
+  bool write(const key_event_t& e) {
+    uint h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == key_event_queue_size) {
+      full = full + 1;
+      return false;
+    }
+    events[h & mask] = e;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+  // reader side
+  uint available() {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+  }
+  bool read(key_event_t& e) {
+    uint t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t) {
+      return false;
+    }
+    e = events[t & mask];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+};
 
 // appears to work on https://binji.github.io/wasm-clang/
 // tested Nov 7 2024
@@ -19,8 +255,37 @@ class pinGrid_obj {
     int_vec _keyState;
     uint _colCounter;
     uint _muxCounter;
-    uint _gridCounter;
-    bool _readComplete;
+    uint _scanMode = key_scan_by_pin;
+    PIO _pio = nullptr;
+    int _sm = N_A;
+    uint _pioOffset = 0;
+    pio_program_t _pioProgram;
+    uint16_t _pioCode[4];
+    int _txChannel = N_A;
+    int _rxChannel = N_A;
+    uint _muxBase = 0;
+    uint _colBase = 0;
+    uint32_t _muxPattern[32];       // mux address as written to the GPIO block
+    uint32_t _muxGPIO[32];          // mux address as written to all GPIOs
+    uint32_t _muxGPIOMask = 0;
+    uint32_t _colMask = 0;
+    uint32_t _scanBuffer[32];       // column samples, one word per mux value
+    key_bitmap_t _keyBits = {};     // the scan just finished
+    uint _bitmapWords = 0;
+    key_bitmap_t _sentBits = {};    // key states as last put in the event queue
+    key_bitmap_t _stableBits = {};  // debounced key states
+    key_bitmap_t _bounceCount[4] = {};   // vertical counter, bit 0..3 of each key's count
+    uint _pressScans = 1;           // scans a press must hold to count
+    uint _releaseScans = 1;         // scans a release must hold to count
+    uint _scanPeriod_uS = 0;
+    uint16_t _chatter[max_key_count] = {};
+    key_event_queue_obj _events;
+    analogKeys_obj _analog;
+    uint _pullupCol = 0;            // the column that has its pull-up on
+    bool _readingActive = false;    // next poll reads an active analog key
+    uint _activeKey = 0;
+    uint _stepsSinceReread = 0;     // regular scan steps since the last extra read
+    volatile uint _scanCount = 0;
     void init_pin_states() {
       for (auto& m : _muxPins) {
         pinMode(m, OUTPUT); 
@@ -37,8 +302,20 @@ class pinGrid_obj {
       pinMode(_colPins[_colCounter], INPUT);
       _colCounter = (++_colCounter) % _colSize;
       pinMode(_colPins[_colCounter], INPUT_PULLUP);
+      _pullupCol = _colCounter;
       return (!(_colCounter));
     }
+    // point the mux and pull-up at any one key
+    void select_key(uint c, uint m) {
+      if (c != _pullupCol) {
+        pinMode(_colPins[_pullupCol], INPUT);
+        pinMode(_colPins[c], INPUT_PULLUP);
+        _pullupCol = c;
+      }
+      for (int b = 0; b < _muxSize; b++) {
+        digitalWrite(_muxPins[b], (m >> b) & 1);
+      }
+    }
     bool advanceMux() {
       _muxCounter = (++_muxCounter) % _muxMaxValue;
       for (int b = 0; b < _muxSize; b++) {
@@ -46,58 +323,379 @@ class pinGrid_obj {
       }
       return (!(_muxCounter));
     }
+    // true if every column can be read with one GPIO read, i.e.
+    // the keys are digital and the column pins are consecutive.
+    // works out the mux address for each value as a GPIO bit pattern.
+    bool pins_fit_one_read() {
+      if (_isAnalog || (_muxSize > 5) || (_colSize > 32)) {
+        return false;
+      }
+      _muxBase = *std::min_element(_muxPins.begin(), _muxPins.end());
+      _colBase = *std::min_element(_colPins.begin(), _colPins.end());
+      _colMask = (_colSize == 32 ? ~0u : (1u << _colSize) - 1);
+      for (uint c = 0; c < _colSize; c++) {
+        if (_colPins[c] != _colBase + c) {
+          return false; // column pins must be consecutive and in order
+        }
+      }
+      _muxGPIOMask = 0;
+      for (auto& m : _muxPins) {
+        _muxGPIOMask |= (1u << m);
+      }
+      if (_muxGPIOMask & (_colMask << _colBase)) {
+        return false;
+      }
+      for (uint v = 0; v < _muxMaxValue; v++) {
+        _muxGPIO[v] = 0;
+        for (uint b = 0; b < _muxSize; b++) {
+          _muxGPIO[v] |= ((v >> b) & 1u) << _muxPins[b];
+        }
+        _muxPattern[v] = _muxGPIO[v] >> _muxBase;
+      }
+      return true;
+    }
+    bool setup_PIO() {
+      if (!pins_fit_one_read()) {
+        return false;
+      }
+      if ((_muxGPIOMask >> _muxBase) != ((1u << _muxSize) - 1)) {
+        return false;   // mux pins must fill a block of consecutive GPIOs
+      }
+      uint settle = constrain(keyboard_mux_settle_in_uS, 1, 32);
+      _pioCode[0] = pio_encode_pull(false, true);
+      _pioCode[1] = pio_encode_out(pio_pins, _muxSize) | pio_encode_delay(settle - 1);
+      _pioCode[2] = pio_encode_in(pio_pins, _colSize);
+      _pioCode[3] = pio_encode_push(false, true);
+      _pioProgram.instructions = _pioCode;
+      _pioProgram.length = 4;
+      _pioProgram.origin = -1;
+      // the NeoPixel library also wants a state machine, so try both blocks
+      for (PIO p : {pio1, pio0}) {
+        if (!pio_can_add_program(p, &_pioProgram)) {
+          continue;
+        }
+        int sm = pio_claim_unused_sm(p, false);
+        if (sm < 0) {
+          continue;
+        }
+        _pio = p;
+        _sm = sm;
+        break;
+      }
+      if (_sm < 0) {
+        return false;
+      }
+      _pioOffset = pio_add_program(_pio, &_pioProgram);
+      for (auto& m : _muxPins) {
+        pio_gpio_init(_pio, m);
+      }
+      for (auto& c : _colPins) {
+        gpio_pull_up(c);   // every column is pulled up all the time
+      }
+      pio_sm_set_consecutive_pindirs(_pio, _sm, _muxBase, _muxSize, true);
+      pio_sm_config cfg = pio_get_default_sm_config();
+      sm_config_set_wrap(&cfg, _pioOffset, _pioOffset + 3);
+      sm_config_set_out_pins(&cfg, _muxBase, _muxSize);
+      sm_config_set_in_pins(&cfg, _colBase);
+      sm_config_set_out_shift(&cfg, true, false, 32);
+      sm_config_set_in_shift(&cfg, false, false, 32);
+      sm_config_set_clkdiv(&cfg, clock_get_hz(clk_sys) / 1'000'000.f);
+      pio_sm_init(_pio, _sm, _pioOffset, &cfg);
+
+      _txChannel = dma_claim_unused_channel(true);
+      dma_channel_config tx = dma_channel_get_default_config(_txChannel);
+      channel_config_set_transfer_data_size(&tx, DMA_SIZE_32);
+      channel_config_set_read_increment(&tx, true);
+      channel_config_set_write_increment(&tx, false);
+      channel_config_set_dreq(&tx, pio_get_dreq(_pio, _sm, true));
+      dma_channel_configure(_txChannel, &tx, &_pio->txf[_sm], _muxPattern, _muxMaxValue, false);
+
+      _rxChannel = dma_claim_unused_channel(true);
+      dma_channel_config rx = dma_channel_get_default_config(_rxChannel);
+      channel_config_set_transfer_data_size(&rx, DMA_SIZE_32);
+      channel_config_set_read_increment(&rx, false);
+      channel_config_set_write_increment(&rx, true);
+      channel_config_set_dreq(&rx, pio_get_dreq(_pio, _sm, false));
+      dma_channel_configure(_rxChannel, &rx, _scanBuffer, &_pio->rxf[_sm], _muxMaxValue, false);
+      return true;
+    }
+    bool setup_parallel() {
+      if (!pins_fit_one_read()) {
+        return false;
+      }
+      for (auto& m : _muxPins) {
+        pinMode(m, OUTPUT);
+      }
+      for (auto& c : _colPins) {
+        pinMode(c, INPUT_PULLUP);
+      }
+      gpio_put_masked(_muxGPIOMask, _muxGPIO[0]);
+      return true;
+    }
+    // column samples read low when a key is pressed. only the low
+    // bits are visited, which is usually none of them.
+    void bits_from_scan_buffer(key_bitmap_t& bits) {
+      bits.fill(0);
+      for (uint m = 0; m < _muxMaxValue; m++) {
+        uint32_t pressed = ~_scanBuffer[m] & _colMask;
+        while (pressed) {
+          uint k = linear_index(__builtin_ctz(pressed), m);
+          pressed &= pressed - 1;
+          if (k < max_key_count) {
+            bits[k >> 5] |= (1u << (k & 31));
+          }
+        }
+      }
+    }
+    void bits_from_key_states(key_bitmap_t& bits) {
+      if (_isAnalog) {
+        bits = _analog.down;
+        return;
+      }
+      bits.fill(0);
+      for (uint k = 0; (k < _keyCount) && (k < max_key_count); k++) {
+        bits[k >> 5] |= (uint32_t)(_keyState[k] == LOW) << (k & 31);
+      }
+    }
+    // all keys whose count equals n, as a bitmap word
+    uint32_t count_equals(uint w, uint n) {
+      uint32_t match = ~0u;
+      for (uint j = 0; j < 4; j++) {
+        match &= (((n >> j) & 1) ? _bounceCount[j][w] : ~_bounceCount[j][w]);
+      }
+      return match;
+    }
+    // raw bits in, debounced bits out
+    void debounce(key_bitmap_t& bits) {
+      for (uint w = 0; w < _bitmapWords; w++) {
+        uint32_t stable = _stableBits[w];
+        uint32_t differs = bits[w] ^ stable;
+        uint32_t counting = _bounceCount[0][w] | _bounceCount[1][w] | _bounceCount[2][w] | _bounceCount[3][w];
+        uint32_t bounced = counting & ~differs;
+        while (bounced) {
+          uint b = __builtin_ctz(bounced);
+          bounced &= bounced - 1;
+          if (_chatter[(w << 5) | b] < UINT16_MAX) {
+            ++_chatter[(w << 5) | b];
+          }
+        }
+        // this is the n-th scan in a row that differs: flip
+        uint32_t flip = differs & (
+            (~stable & count_equals(w, _pressScans - 1))
+          | ( stable & count_equals(w, _releaseScans - 1)));
+        stable ^= flip;
+        // count up where still differing, clear everywhere else
+        uint32_t keep = differs & ~flip;
+        uint32_t carry = ~0u;
+        for (uint j = 0; j < 4; j++) {
+          uint32_t c = _bounceCount[j][w];
+          _bounceCount[j][w] = (c ^ carry) & keep;
+          carry &= c;
+        }
+        _stableBits[w] = stable;
+        bits[w] = stable;
+      }
+    }
+    uint scans_for(uint hold_uS) {
+      uint n = (hold_uS + _scanPeriod_uS - 1) / _scanPeriod_uS;
+      return constrain(n, 1u, 16u);
+    }
+    // queue an event for each key that differs from what was last sent.
+    // only the changed bits are visited.
+    void queue_key_events(const key_bitmap_t& bits) {
+      // the change was first seen this many scans ago
+      time_uS now = getTheCurrentTime();
+      time_uS pressedAt  = now - (time_uS)(_pressScans   - 1) * _scanPeriod_uS;
+      time_uS releasedAt = now - (time_uS)(_releaseScans - 1) * _scanPeriod_uS;
+      for (uint w = 0; w < _bitmapWords; w++) {
+        uint32_t changed = bits[w] ^ _sentBits[w];
+        while (changed) {
+          uint b = __builtin_ctz(changed);
+          changed &= changed - 1;
+          uint k = (w << 5) | b;
+          bool pressed = (bits[w] >> b) & 1;
+          uint8_t vel = ((pressed && _isAnalog) ? _analog.velocity(k) : 0);
+          key_event_t e = { (uint16_t)k, pressed, (pressed ? pressedAt : releasedAt), vel };
+          if (_events.write(e)) {
+            _sentBits[w] ^= (1u << b);
+          }
+        }
+      }
+    }
+    // a whole scan is in. queue the keys that changed.
+    void finish_scan() {
+      ++_scanCount;
+      if (_isAnalog) {
+        _analog.end_of_scan();
+      }
+      if (_scanMode == key_scan_by_pin) {
+        bits_from_key_states(_keyBits);
+      } else {
+        bits_from_scan_buffer(_keyBits);
+      }
+      debounce(_keyBits);
+      queue_key_events(_keyBits);
+    }
+    // the state machine waits on an empty TX FIFO between scans,
+    // so re-arming both channels keeps address and sample in step.
+    void start_scan() {
+      dma_channel_set_write_addr(_rxChannel, _scanBuffer, false);
+      dma_channel_set_trans_count(_rxChannel, _muxMaxValue, false);
+      dma_channel_set_read_addr(_txChannel, _muxPattern, false);
+      dma_channel_set_trans_count(_txChannel, _muxMaxValue, false);
+      dma_start_channel_mask((1u << _rxChannel) | (1u << _txChannel));
+    }
   public:
     uint linear_index(uint c, uint m) {
       return ((c << _muxSize) | m);
     }
-    void resume_background_process() {
-      _readComplete = false;
-      _gridCounter = 0;
-    }
-    void setup(byte_vec colPins, bool isAnalog, byte_vec muxPins, bool cycleMuxFirst = true) {
+    // falls back to a parallel scan, then to scanning by pin,
+    // if the wiring does not suit the mode asked for.
+    void setup(byte_vec colPins, bool isAnalog, byte_vec muxPins, bool cycleMuxFirst = true, uint scanMode = key_scan_by_pin) {
       _isAnalog = isAnalog;
       _colPins = colPins;
       _muxPins = muxPins;
-      init_pin_states();
 
       _colSize = _colPins.size();
       _muxSize = _muxPins.size();
       _muxMaxValue = (1u << _muxSize);
       _keyCount = (_colSize << _muxSize);
       _keyState.resize(_keyCount);
+      _bitmapWords = (std::min(_keyCount, max_key_count) + 31) / 32;
+      _keyBits.fill(0);
 
       _colCounter = 0;
       _muxCounter = 0;
       _cycle_mux_pins_first = cycleMuxFirst;
-      resume_background_process();
+      _scanMode = key_scan_by_pin;
+      if (_isAnalog) {
+        scanMode = key_scan_by_pin;   // only the pin scan can use analogRead
+      }
+      if ((scanMode == key_scan_by_PIO) && setup_PIO()) {
+        _scanMode = key_scan_by_PIO;
+      } else if ((scanMode != key_scan_by_pin) && setup_parallel()) {
+        _scanMode = key_scan_parallel;
+      } else {
+        init_pin_states();
+      }
+      switch (_scanMode) {
+        case key_scan_by_PIO:   _scanPeriod_uS = _muxMaxValue * (constrain(keyboard_mux_settle_in_uS, 1, 32) + 3); break;
+        case key_scan_parallel: _scanPeriod_uS = _muxMaxValue * keyboard_mux_settle_in_uS;                        break;
+        default:                _scanPeriod_uS = _keyCount * keyboard_pin_reset_period_in_uS;                     break;
+      }
+      if (_isAnalog) {
+        _scanPeriod_uS += _scanPeriod_uS / analog_reread_every;   // worst case, with keys held
+        set_debounce(0, 0);   // the press / release points already have hysteresis
+      } else {
+        set_debounce(key_press_debounce_in_uS, key_release_debounce_in_uS);
+      }
+    }
+    bool is_analog() {
+      return _isAnalog;
+    }
+    // calibration and pressure of analog keys
+    analogKeys_obj& analog() {
+      return _analog;
+    }
+    uint8_t get_key_pressure(uint keyIndex) {
+      return (_isAnalog && keyIndex < max_key_count ? _analog.pressure(keyIndex) : 0);
+    }
+    // how long a press / release must hold before it counts
+    void set_debounce(uint press_uS, uint release_uS) {
+      _pressScans = scans_for(press_uS);
+      _releaseScans = scans_for(release_uS);
+    }
+    uint scan_period_uS() {
+      return _scanPeriod_uS;
+    }
+    // bounces seen on one key since the last reset
+    uint get_chatter_count(uint keyIndex) {
+      return (keyIndex < max_key_count ? _chatter[keyIndex] : 0);
+    }
+    void reset_chatter_counts() {
+      std::fill(_chatter, _chatter + max_key_count, 0);
+    }
+    uint scan_mode() {
+      return _scanMode;
+    }
+    // call from the core that should take the scan interrupt
+    void begin_PIO() {
+      if (_scanMode != key_scan_by_PIO) {
+        return;
+      }
+      dma_channel_set_irq1_enabled(_rxChannel, true);
+      irq_add_shared_handler(DMA_IRQ_1, on_key_scan_DMA_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+      irq_set_enabled(DMA_IRQ_1, true);
+      pio_sm_set_enabled(_pio, _sm, true);
+      start_scan();
+    }
+    void service_scan_irq() {
+      if (!dma_channel_get_irq1_status(_rxChannel)) {
+        return;
+      }
+      dma_channel_acknowledge_irq1(_rxChannel);
+      finish_scan();
+      start_scan();
+    }
+    // number of complete scans since boot
+    uint scan_count() {
+      return _scanCount;
     }
     void poll() {
-      if (!(_readComplete)) {
-        if (_isAnalog) {
-          _keyState[linear_index(_colCounter,_muxCounter)] = analogRead(_colPins[_colCounter]);
-        } else {
-          _keyState[linear_index(_colCounter,_muxCounter)] = digitalRead(_colPins[_colCounter]);
+      if (_scanMode == key_scan_parallel) {
+        _scanBuffer[_muxCounter] = (gpio_get_all() >> _colBase) & _colMask;
+        _muxCounter = (_muxCounter + 1) & (_muxMaxValue - 1);
+        gpio_put_masked(_muxGPIOMask, _muxGPIO[_muxCounter]);
+        if (!_muxCounter) {
+          finish_scan();
         }
-        ++_gridCounter;
-        if (_cycle_mux_pins_first) {
-          if (advanceMux()) {
-            _readComplete = advanceCol();
-          }
-        } else {
-          if (advanceCol()) {
-            _readComplete = advanceMux();
-          }
+        return;
+      }
+      if (_isAnalog) {
+        uint32_t now = timer_hw->timerawl;
+        if (_readingActive) {
+          // an extra read of a moving key, then back to the regular scan
+          _analog.process(_activeKey, analogRead(_colPins[_activeKey >> _muxSize]), now);
+          _readingActive = false;
+          select_key(_colCounter, _muxCounter);
+          return;
+        }
+        uint k = linear_index(_colCounter,_muxCounter);
+        _keyState[k] = analogRead(_colPins[_colCounter]);
+        if (k < max_key_count) {
+          _analog.process(k, _keyState[k], now);
         }
+      } else {
+        _keyState[linear_index(_colCounter,_muxCounter)] = digitalRead(_colPins[_colCounter]);
+      }
+      if (_cycle_mux_pins_first) {
+        if (advanceMux() && advanceCol()) {
+          finish_scan();
+        }
+      } else {
+        if (advanceCol() && advanceMux()) {
+          finish_scan();
+        }
+      }
+      // one tick in every analog_reread_every + 1 goes to the active
+      // keys in turn, if there are any, so the scan keeps its pace
+      if (_isAnalog && (++_stepsSinceReread >= analog_reread_every)
+        && _analog.next_active(_activeKey, _bitmapWords, _activeKey)) {
+        _stepsSinceReread = 0;
+        select_key(_activeKey >> _muxSize, _activeKey & (_muxMaxValue - 1));
+        _readingActive = true;
       }
     }
-    bool is_background_process_complete() {
-      return _readComplete;
+    // next key press / release, oldest first. core 0 only.
+    bool read_key_event(key_event_t& e) {
+      return _events.read(e);
     }
-    int read_key_state(uint muxCtr, uint colCtr) {
-      return _keyState[linear_index(colCtr,muxCtr)];
+    // events that had to wait a scan because the queue was full
+    uint get_key_queue_full() {
+      return _events.full;
     }
-    int read_key_state(uint keyIndex) {
-      return _keyState[keyIndex];
+    void reset_key_queue_full() {
+      _events.full = 0;
     }
     uint colPinCount() {
       return _colSize;
@@ -109,4 +707,8 @@ class pinGrid_obj {
       return _keyCount;
     }
 };
-pinGrid_obj pinGrid;
\ No newline at end of file
+pinGrid_obj pinGrid;
+
+static void on_key_scan_DMA_irq() {
+  pinGrid.service_scan_irq();
+}
\ No newline at end of file
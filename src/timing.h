@@ -7,6 +7,50 @@ time_uS getTheCurrentTime() {
   return (temp << 32) | timer_hw->timerawl;
 }
 
+// timer_hw->timerawl is the low 32 bits of the microsecond timer.
+// it wraps every ~71 minutes, so compare times using the difference.
+inline bool time_reached(uint32_t now, uint32_t deadline) {
+  return ((int32_t)(now - deadline) >= 0);
+}
+
+// running statistics for one background task.
+// times are sampled from the 1 uS timer, which is cheap to read
+// from inside the interrupt. the averages are worked out on request.
+struct task_stats_t {
+  uint runs = 0;
+  uint exec_min = ~0u;          // run time of the task, in uS
+  uint exec_max = 0;
+  uint64_t exec_total = 0;
+  uint jitter_max = 0;          // how late the task started vs. its deadline, in uS
+  uint64_t jitter_total = 0;
+  uint missed = 0;              // deadlines that passed without a run
+  uint deferred = 0;            // ticks where the task was due but held back
+  uint32_t since = 0;           // timer value when the stats were last reset
+  void record(uint exec_uS, uint late_uS) {
+    ++runs;
+    exec_total += exec_uS;
+    if (exec_uS < exec_min) exec_min = exec_uS;
+    if (exec_uS > exec_max) exec_max = exec_uS;
+    jitter_total += late_uS;
+    if (late_uS > jitter_max) jitter_max = late_uS;
+  }
+  uint exec_avg() {
+    return (runs ? exec_total / runs : 0);
+  }
+  uint jitter_avg() {
+    return (runs ? jitter_total / runs : 0);
+  }
+  // share of the core used by this task, in tenths of a percent
+  uint load_permille(uint32_t now) {
+    uint32_t elapsed = now - since;
+    return (elapsed ? (exec_total * 1000) / elapsed : 0);
+  }
+  void reset(uint32_t now) {
+    *this = task_stats_t();
+    since = now;
+  }
+};
+
 class softTimer {
   private:
     time_uS startTime;
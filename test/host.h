@@ -0,0 +1,32 @@
+#pragma once
+// the firmware headers, built for a computer. they are included in
+// the same order as HexBoardv1_1.ino, up to the synth, with the
+// Arduino and pico SDK headers taken from stub/. each test is one
+// translation unit, like the sketch.
+#include <Arduino.h>
+#define HARDWARE_UNKNOWN 0
+#define HARDWARE_V1_1 1
+#define HARDWARE_V1_2 2
+byte Hardware_Version = HARDWARE_UNKNOWN;
+
+#include "../src/V1_diagnostics.h"
+#include "../src/utils.h"
+#include "../src/config.h"
+#include "../src/timing.h"
+#include "../src/hardware.h"
+#include "../src/V1_defaults.h"
+#include "../src/V1_microtonal.h"
+#include "../src/V1_scales.h"
+#include "../src/V1_layout.h"
+#include "../src/V1_palettes.h"
+#include "../src/V1_presets.h"
+#include "host_grid.h"
+#include "../src/V1_1_synth.h"
+
+// each test prints a line per check, and main() returns hostFailures
+// so that `make check` stops at the first test that failed.
+int hostFailures = 0;
+void host_expect(bool ok, const str& what) {
+  printf("%s: %s\n", what.c_str(), (ok ? "ok" : "FAILED"));
+  hostFailures += !ok;
+}
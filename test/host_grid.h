@@ -0,0 +1,34 @@
+#pragma once
+// stand-in for the parts of V1_1_gridSystem.h, V1_LED.h and
+// V1_MIDImsg.h that the synth uses. the real grid is built from
+// the board's wiring and its wheels look up keys as the program
+// starts, so it cannot be included without the board.
+#include <vector>
+
+struct music_key_t {
+  uint8_t  note = UNUSED_NOTE;
+  uint8_t  MIDIch = 0;
+  uint8_t  synthCh = 0;
+  float    frequency = 0.0;
+  uint8_t  velocity = 0;
+};
+struct switchboard_t {
+  std::vector<music_key_t> keys;
+};
+switchboard_t hexBoard;
+
+struct wheelDef {
+  int16_t curValue = 0;
+};
+wheelDef modWheel;
+wheelDef pbWheel;
+wheelDef velWheel;
+
+#define CONCERT_A_HZ 440.0
+#define PITCH_BEND_SEMIS 2
+float freqToMIDI(float Hz) {
+  return 69.0 + 12.0 * log2f(Hz / 440.0);
+}
+float MIDItoFreq(float midi) {
+  return 440.0 * exp2((midi - 69.0) / 12.0);
+}
@@ -0,0 +1,76 @@
+/*
+  The key event queue, from the scanner on core 1 to the interface
+  on core 0. First, bursts of events, more than the queue holds, go
+  through it the way the scanner sends them: a write that finds the
+  queue full is tried again after the reader has caught up a little.
+  Then a writer and a reader thread pass events through it at full
+  speed, the way the two cores do. Every event must come out once,
+  in order.
+*/
+#include "host.h"
+#include <thread>
+
+key_event_t numbered_event(uint n) {
+  return { (uint16_t)n, (bool)(n & 1), (time_uS)n * 7, (uint8_t)(n & 127) };
+}
+bool is_numbered(const key_event_t& e, uint n) {
+  key_event_t want = numbered_event(n);
+  return (e.hwKey == want.hwKey) && (e.pressed == want.pressed)
+    && (e.timestamp == want.timestamp) && (e.velocity == want.velocity);
+}
+
+const uint burstCount = 8;
+const uint burstSize = key_event_queue_size + key_event_queue_size / 2;
+const uint readChunk = 40;
+void check_bursts() {
+  key_event_queue_obj q;
+  uint errors = 0;
+  uint written = 0;
+  uint expected = 0;
+  for (uint b = 0; b < burstCount; b++) {
+    uint end = written + burstSize;
+    while (expected < end) {
+      while ((written < end) && q.write(numbered_event(written))) {
+        ++written;
+      }
+      key_event_t e;
+      for (uint r = 0; (r < readChunk) && q.read(e); r++) {
+        errors += !is_numbered(e, expected);
+        ++expected;
+      }
+    }
+  }
+  host_expect(!errors && !q.available(), "key queue: " + std::to_string(burstCount) + " bursts of " +
+    std::to_string(burstSize) + " events in order, " + std::to_string(errors) + " errors");
+  host_expect(q.full > 0, "key queue: the bursts filled the queue, " + std::to_string(q.full) + " retries");
+}
+
+const uint threadedEvents = 200000;
+void check_threads() {
+  key_event_queue_obj q;
+  std::thread writer([&q] {
+    for (uint n = 0; n < threadedEvents; n++) {
+      while (!q.write(numbered_event(n))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint errors = 0;
+  uint expected = 0;
+  while (expected < threadedEvents) {
+    key_event_t e;
+    if (q.read(e)) {
+      errors += !is_numbered(e, expected);
+      ++expected;
+    }
+  }
+  writer.join();
+  host_expect(!errors && !q.available(), "key queue: " + std::to_string(threadedEvents) +
+    " events between two threads in order, " + std::to_string(errors) + " errors");
+}
+
+int main() {
+  check_bursts();
+  check_threads();
+  return hostFailures;
+}
@@ -0,0 +1,158 @@
+/*
+  The plucked string and its pool of delay lines.
+  First the pitch: a string is plucked on every step of 31 and
+  53 equal, from A2 to A6, and the pitch that comes out is
+  measured. The phase at the expected frequency is taken over
+  two windows one after the other, and how far it moved in
+  between says how far off the real frequency is. Every step
+  must be within a cent.
+  Then the pool: low notes are played until it is full, and
+  the number of voices must be what fits. The lines must never
+  overlap while notes are started, stolen and released, and the
+  pool must be whole again once every voice is silent.
+*/
+#include "host.h"
+
+#define PLUCK_TUNING_WINDOW 2048
+// phase of x at frequency w (radians per sample), Hann windowed.
+// the sines are stepped by rotation rather than called per sample.
+float phase_at(const int16_t* x, uint n, float w) {
+  float re = 0;
+  float im = 0;
+  float c = 1;
+  float s = 0;
+  float hc = 1;
+  float hs = 0;
+  float dc = cosf(w);
+  float ds = sinf(w);
+  float dhc = cosf(2 * PI / n);
+  float dhs = sinf(2 * PI / n);
+  for (uint i = 0; i < n; i++) {
+    float h = x[i] * (1 - hc);
+    re += h * c;
+    im -= h * s;
+    float t = c * dc - s * ds;
+    s = s * dc + c * ds;
+    c = t;
+    t = hc * dhc - hs * dhs;
+    hs = hs * dhc + hc * dhs;
+    hc = t;
+  }
+  return atan2f(im, re);
+}
+float pluck_measured_frequency(float f, uint rate) {
+  uint len = pluck_voice_t::length_for(f, rate);
+  std::vector<int16_t> line(len);
+  std::vector<int16_t> x(2 * PLUCK_TUNING_WINDOW);
+  pluck_voice_t p;
+  uint32_t seed = 1;
+  p.excite(line.data(), len, f, rate, seed);
+  for (uint s = 0; s < len * 4; s++) {
+    p.next(line.data(), len);    // let the noise settle into a tone
+  }
+  for (auto& s : x) {
+    s = p.next(line.data(), len);
+  }
+  float w = 2 * PI * f / rate;
+  float moved = phase_at(x.data() + PLUCK_TUNING_WINDOW, PLUCK_TUNING_WINDOW, w) - phase_at(x.data(), PLUCK_TUNING_WINDOW, w)
+              - w * PLUCK_TUNING_WINDOW;
+  moved -= 2 * PI * round(moved / (2 * PI));
+  return f + moved * rate / (2 * PI * PLUCK_TUNING_WINDOW);
+}
+void check_tuning() {
+  const uint edos[] = {31, 53};
+  uint rate = audioOut.get_sample_rate();
+  for (auto edo : edos) {
+    float worst = 0;
+    for (uint step = 0; step <= 4 * edo; step++) {
+      float f = 110.0 * exp2f((float)step / edo);
+      worst = std::max(worst, fabsf(1200 * log2f(pluck_measured_frequency(f, rate) / f)));
+    }
+    host_expect(worst < 1, "pluck tuning: worst error " + std::to_string(worst) + " cents in " + std::to_string(edo) + " equal");
+  }
+  host_expect(pluck_voice_t::length_for(MIDItoFreq(127), rate) > 0, "pluck tuning: MIDI note 127 has a line");
+}
+
+// every line in the pool, playing or waiting, is inside it and apart from the others
+bool pool_lines_apart() {
+  const uint slots = 2 * POLYPHONY_LIMIT;
+  for (uint a = 0; a < slots; a++) {
+    if (!pluckPool.length[a]) {
+      continue;
+    }
+    if (pluckPool.start[a] + pluckPool.length[a] > PLUCK_POOL_SAMPLES) {
+      return false;
+    }
+    for (uint b = a + 1; b < slots; b++) {
+      if (pluckPool.length[b] && (pluckPool.start[a] < pluckPool.start[b] + pluckPool.length[b])
+        && (pluckPool.start[b] < pluckPool.start[a] + pluckPool.length[a])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+// render like core 1 does, and free the silent voices like core 0
+uint render_blocks(uint blocks) {
+  uint peak = 0;
+  audio_sample out[SYNTH_BLOCK_SIZE];
+  for (uint b = 0; b < blocks; b++) {
+    synth.render(out, SYNTH_BLOCK_SIZE);
+    for (auto s : out) {
+      peak = std::max(peak, (uint)abs((int)s - 32768));
+    }
+    synth_reclaim_voices();
+  }
+  return peak;
+}
+void check_pool() {
+  currWave = WAVEFORM_PLUCK;
+  playbackMode = SYNTH_POLY;
+  synthPolyphony = POLYPHONY_LIMIT;
+  hexBoard.keys.resize(POLYPHONY_LIMIT + 4);
+  synth_set_polyphony();
+  float low = 55.0;
+  uint fits = PLUCK_POOL_SAMPLES / pluck_voice_t::length_for(low, audioOut.get_sample_rate());
+  uint played = 0;
+  for (auto& h : hexBoard.keys) {
+    h.frequency = low;
+    h.velocity = 127;
+    trySynthNoteOn(h);
+    played += (h.synthCh != 0);
+  }
+  host_expect(played == std::min<uint>(fits, POLYPHONY_LIMIT), "pluck pool: " + std::to_string(played) +
+    " voices at " + std::to_string((int)low) + " Hz, " + std::to_string(fits) + " fit");
+  uint peak = render_blocks(100);
+  bool taken = true;
+  for (auto& p : synth.pluck) {
+    taken = taken && !p.nextLine;
+  }
+  host_expect(taken && (peak > 0), "pluck pool: the renderer took up every string and played it");
+  bool apart = pool_lines_apart();
+  for (uint n = 0; n < 2000; n++) {
+    music_key_t& h = hexBoard.keys[n % hexBoard.keys.size()];
+    if (h.synthCh) {
+      trySynthNoteOff(h);
+    }
+    h.frequency = MIDItoFreq(33 + (n * 7) % 60);
+    trySynthNoteOn(h);    // steals and retriggers once the voices run out
+    apart = apart && pool_lines_apart();
+    render_blocks(1 + n % 3);
+    apart = apart && pool_lines_apart();
+  }
+  host_expect(apart, "pluck pool: no two lines overlapped while notes came and went");
+  for (auto& h : hexBoard.keys) {
+    trySynthNoteOff(h);
+  }
+  render_blocks(4 * audioOut.get_sample_rate() / SYNTH_BLOCK_SIZE);
+  host_expect(pluckPool.free_samples() == PLUCK_POOL_SAMPLES, "pluck pool: all " +
+    std::to_string(PLUCK_POOL_SAMPLES) + " samples free once the notes died away");
+}
+
+int main() {
+  hardware_setup();
+  synth_setup();
+  check_tuning();
+  check_pool();
+  return hostFailures;
+}
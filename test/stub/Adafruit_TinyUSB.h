@@ -0,0 +1,12 @@
+#pragma once
+// Serial is in the Arduino.h stand-in
+#include "Arduino.h"
+
+class Adafruit_USBD_MIDI {
+  public:
+    void setStringDescriptor(const char*) {}
+};
+struct host_usb_device_obj {
+  bool mounted() { return true; }
+};
+inline host_usb_device_obj TinyUSBDevice;
@@ -0,0 +1,62 @@
+#pragma once
+// stand-in for the parts of the Arduino core (arduino-pico) that the
+// firmware headers use, so they can be built and tested on a computer.
+// pins read as released and writes go nowhere.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include "hardware/sync.h"   // tight_loop_contents
+
+typedef uint8_t byte;
+
+#define PI 3.1415926535897932384626433832795
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int digitalRead(int) { return HIGH; }
+inline int analogRead(int) { return 0; }
+
+// the host clock, in microseconds since the program started
+inline uint64_t host_micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+inline unsigned long micros() { return host_micros(); }
+inline unsigned long millis() { return host_micros() / 1000; }
+inline void delay(unsigned long) {}
+inline void delayMicroseconds(unsigned int) {}
+
+// the firmware's log goes nowhere unless HOST_LOG is set
+struct host_serial_obj {
+  void begin(unsigned long) {}
+  void println(const char* s) {
+    if (getenv("HOST_LOG")) {
+      puts(s);
+    }
+  }
+};
+inline host_serial_obj Serial;
+
+// the host has no cycle counter like the RP2040's, so time on the
+// host clock is counted in ticks of a clock at the RP2040's speed.
+// a computer is several times faster, so the counts are only good
+// for comparing one build with another on the same machine.
+struct host_rp2040_obj {
+  uint32_t f_cpu() { return 133000000; }
+  uint32_t getCycleCount() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t).count() * 133 / 1000;
+  }
+};
+inline host_rp2040_obj rp2040;
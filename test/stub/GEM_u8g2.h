@@ -0,0 +1,6 @@
+#pragma once
+// the menu is not built on the host, only the option type the tunings use
+struct SelectOptionInt {
+  const char* name;
+  int val_int;
+};
@@ -0,0 +1,37 @@
+#pragma once
+// flash files are ordinary files on the host, in the working directory
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+struct File {
+  FILE* fp = nullptr;
+  operator bool() const { return fp; }
+  size_t size() {
+    long at = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, at, SEEK_SET);
+    return n;
+  }
+  size_t read(uint8_t* buf, size_t n) { return fread(buf, 1, n, fp); }
+  size_t write(const uint8_t* buf, size_t n) { return fwrite(buf, 1, n, fp); }
+  size_t write(uint8_t b) { return fwrite(&b, 1, 1, fp); }
+  void close() {
+    fclose(fp);
+    fp = nullptr;
+  }
+};
+struct LittleFSConfig {
+  void setAutoFormat(bool) {}
+};
+struct host_fs_obj {
+  void setConfig(const LittleFSConfig&) {}
+  bool begin() { return true; }
+  File open(const char* path, const char* mode) {
+    File f;
+    f.fp = fopen((std::string(".") + path).c_str(), (mode[0] == 'w' ? "wb" : "rb"));
+    return f;
+  }
+};
+inline host_fs_obj LittleFS;
@@ -0,0 +1,2 @@
+#pragma once
+// nothing on the host uses I2C
@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+enum clock_index { clk_sys = 5 };
+inline uint32_t clock_get_hz(clock_index) { return 133000000; }
@@ -0,0 +1,36 @@
+#pragma once
+// DMA channels can be claimed and configured on the host, but never run
+#include <stdint.h>
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16 = 1, DMA_SIZE_32 = 2 };
+struct dma_channel_config {
+  uint32_t ctrl;
+};
+struct dma_hw_t {
+  volatile uint32_t abort;
+};
+inline dma_hw_t host_dma_hw;
+#define dma_hw (&host_dma_hw)
+
+inline int dma_claim_unused_channel(bool) {
+  static int next = 0;
+  return next++ % 12;
+}
+inline void dma_channel_unclaim(unsigned int) {}
+inline int dma_claim_unused_timer(bool) { return 0; }
+inline void dma_timer_set_fraction(unsigned int, uint16_t, uint16_t) {}
+inline unsigned int dma_get_timer_dreq(unsigned int timer) { return 0x3b + timer; }
+inline dma_channel_config dma_channel_get_default_config(unsigned int) { return {0}; }
+inline void channel_config_set_transfer_data_size(dma_channel_config*, dma_channel_transfer_size) {}
+inline void channel_config_set_read_increment(dma_channel_config*, bool) {}
+inline void channel_config_set_write_increment(dma_channel_config*, bool) {}
+inline void channel_config_set_dreq(dma_channel_config*, unsigned int) {}
+inline void channel_config_set_chain_to(dma_channel_config*, unsigned int) {}
+inline void dma_channel_configure(unsigned int, const dma_channel_config*, volatile void*, const volatile void*, unsigned int, bool) {}
+inline void dma_channel_set_read_addr(unsigned int, const volatile void*, bool) {}
+inline void dma_channel_set_write_addr(unsigned int, volatile void*, bool) {}
+inline void dma_channel_set_trans_count(unsigned int, uint32_t, bool) {}
+inline void dma_start_channel_mask(uint32_t) {}
+inline void dma_channel_set_irq1_enabled(unsigned int, bool) {}
+inline bool dma_channel_get_irq1_status(unsigned int) { return false; }
+inline void dma_channel_acknowledge_irq1(unsigned int) {}
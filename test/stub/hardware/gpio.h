@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+
+enum gpio_function { GPIO_FUNC_PWM = 4 };
+inline void gpio_set_function(unsigned int, gpio_function) {}
+inline void gpio_pull_up(unsigned int) {}
+inline void gpio_put_masked(uint32_t, uint32_t) {}
+inline uint32_t gpio_get_all() { return ~0u; }   // every column reads released
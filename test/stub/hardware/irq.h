@@ -0,0 +1,13 @@
+#pragma once
+// interrupt handlers are never called on the host
+#include "hardware/sync.h"
+
+#define DMA_IRQ_1 12
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+
+typedef void (*irq_handler_t)();
+inline void irq_set_enabled(unsigned int, bool) {}
+inline void irq_set_exclusive_handler(unsigned int, irq_handler_t) {}
+inline void irq_add_shared_handler(unsigned int, irq_handler_t, uint8_t) {}
+inline void hw_set_bits(volatile uint32_t* reg, uint32_t mask) { *reg |= mask; }
+inline void hw_clear_bits(volatile uint32_t* reg, uint32_t mask) { *reg &= ~mask; }
@@ -0,0 +1,44 @@
+#pragma once
+// there is no PIO on the host: no program fits, so the scanner
+// falls back to scanning the pins itself
+#include "hardware/gpio.h"
+
+struct pio_hw_t {
+  volatile uint32_t txf[4];
+  volatile uint32_t rxf[4];
+};
+typedef pio_hw_t* PIO;
+inline pio_hw_t host_pio[2];
+#define pio0 (&host_pio[0])
+#define pio1 (&host_pio[1])
+
+struct pio_program_t {
+  const uint16_t* instructions;
+  uint8_t length;
+  int8_t origin;
+};
+struct pio_sm_config {
+  uint32_t clkdiv;
+};
+enum pio_src_dest { pio_pins = 0 };
+
+inline uint16_t pio_encode_pull(bool, bool) { return 0; }
+inline uint16_t pio_encode_push(bool, bool) { return 0; }
+inline uint16_t pio_encode_out(pio_src_dest, unsigned int) { return 0; }
+inline uint16_t pio_encode_in(pio_src_dest, unsigned int) { return 0; }
+inline uint16_t pio_encode_delay(unsigned int) { return 0; }
+inline bool pio_can_add_program(PIO, const pio_program_t*) { return false; }
+inline unsigned int pio_add_program(PIO, const pio_program_t*) { return 0; }
+inline int pio_claim_unused_sm(PIO, bool) { return -1; }
+inline void pio_gpio_init(PIO, unsigned int) {}
+inline void pio_sm_set_consecutive_pindirs(PIO, unsigned int, unsigned int, unsigned int, bool) {}
+inline pio_sm_config pio_get_default_sm_config() { return {0}; }
+inline void sm_config_set_wrap(pio_sm_config*, unsigned int, unsigned int) {}
+inline void sm_config_set_out_pins(pio_sm_config*, unsigned int, unsigned int) {}
+inline void sm_config_set_in_pins(pio_sm_config*, unsigned int) {}
+inline void sm_config_set_out_shift(pio_sm_config*, bool, bool, unsigned int) {}
+inline void sm_config_set_in_shift(pio_sm_config*, bool, bool, unsigned int) {}
+inline void sm_config_set_clkdiv(pio_sm_config*, float) {}
+inline void pio_sm_init(PIO, unsigned int, unsigned int, const pio_sm_config*) {}
+inline void pio_sm_set_enabled(PIO, unsigned int, bool) {}
+inline unsigned int pio_get_dreq(PIO, unsigned int, bool) { return 0; }
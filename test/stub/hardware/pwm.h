@@ -0,0 +1,24 @@
+#pragma once
+// the PWM slices on the host are plain memory
+#include "hardware/gpio.h"
+
+struct pwm_slice_hw_t {
+  volatile uint32_t csr;
+  volatile uint32_t div;
+  volatile uint32_t ctr;
+  volatile uint32_t cc;
+  volatile uint32_t top;
+};
+struct pwm_hw_t {
+  pwm_slice_hw_t slice[8];
+};
+inline pwm_hw_t host_pwm_hw;
+#define pwm_hw (&host_pwm_hw)
+
+inline unsigned int pwm_gpio_to_slice_num(unsigned int gpio) { return (gpio >> 1) & 7; }
+inline unsigned int pwm_gpio_to_channel(unsigned int gpio) { return gpio & 1; }
+inline void pwm_set_phase_correct(unsigned int, bool) {}
+inline void pwm_set_wrap(unsigned int, uint16_t) {}
+inline void pwm_set_clkdiv(unsigned int, float) {}
+inline void pwm_set_gpio_level(unsigned int, uint16_t) {}
+inline void pwm_set_enabled(unsigned int, bool) {}
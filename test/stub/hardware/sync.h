@@ -0,0 +1,7 @@
+#pragma once
+// there are no interrupts on the host
+#include <stdint.h>
+
+inline uint32_t save_and_disable_interrupts() { return 0; }
+inline void restore_interrupts(uint32_t) {}
+inline void tight_loop_contents() {}
@@ -0,0 +1,19 @@
+#pragma once
+// the microsecond timer reads the host clock
+#include "Arduino.h"
+
+struct host_timer_low_reg {
+  operator uint32_t() const { return (uint32_t)host_micros(); }
+};
+struct host_timer_high_reg {
+  operator uint32_t() const { return (uint32_t)(host_micros() >> 32); }
+};
+struct host_timer_hw_t {
+  host_timer_low_reg timerawl;
+  host_timer_high_reg timerawh;
+  volatile uint32_t alarm[4];
+  volatile uint32_t inte;
+  volatile uint32_t intr;
+};
+inline host_timer_hw_t host_timer_hw;
+#define timer_hw (&host_timer_hw)
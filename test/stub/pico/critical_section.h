@@ -0,0 +1,10 @@
+#pragma once
+// on the host a critical section is a mutex, so tests may use threads
+#include <mutex>
+
+struct critical_section_t {
+  std::mutex m;
+};
+inline void critical_section_init(critical_section_t*) {}
+inline void critical_section_enter_blocking(critical_section_t* cs) { cs->m.lock(); }
+inline void critical_section_exit(critical_section_t* cs) { cs->m.unlock(); }
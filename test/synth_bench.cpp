@@ -0,0 +1,97 @@
+/*
+  What one synth sample costs, one sample at a time with
+  next_sample() vs. a block at a time with render(), at 1, 8
+  and 16 voices, on copies of the synth. Each figure is the best
+  of a few runs. The cycles are host time counted at the RP2040's
+  clock (see stub/Arduino.h), so they only compare one build
+  with another; the board logs its own figures at boot. With
+  more than one voice, render() must be the cheaper of the two.
+  The output filters must also fit in AUDIO_FILTER_BUDGET_PERCENT
+  of a sample period, and FM_BUDGET_VOICES voices of FM in what
+  is left of SYNTH_CPU_BUDGET_PERCENT.
+*/
+#include "host.h"
+
+const uint benchSamples = 1 << 16;
+const uint benchRuns = 5;
+volatile uint32_t benchKeep;    // so the loops are not optimised away
+
+// best cycles per sample of "run", which makes benchSamples samples
+template <typename F>
+float best_cycles(F run) {
+  uint32_t best = UINT32_MAX;
+  for (uint r = 0; r < benchRuns; r++) {
+    uint32_t start = rp2040.getCycleCount();
+    run();
+    best = std::min(best, rp2040.getCycleCount() - start);
+  }
+  return (float)best / benchSamples;
+}
+
+// both pins' filters, which come off the synth's budget
+void check_filters() {
+  uint32_t budget = (rp2040.f_cpu() / audioOut.get_sample_rate()) * AUDIO_FILTER_BUDGET_PERCENT / 100;
+  uint32_t cycles = UINT32_MAX;
+  for (uint r = 0; r < benchRuns; r++) {
+    cycles = std::min(cycles, audio_filter_cycles());
+  }
+  host_expect(cycles <= budget, "audio filter bench: " + std::to_string(cycles) +
+    " host cyc/smp for both pins, budget " + std::to_string(budget));
+}
+
+// FM, the costliest waveform, at the voices it promises
+void check_fm() {
+  uint32_t budget = (rp2040.f_cpu() / audioOut.get_sample_rate()) * SYNTH_CPU_BUDGET_PERCENT / 100;
+  budget -= std::min(budget, audio_filter_cycles());
+  uint32_t cycles = UINT32_MAX;
+  for (uint r = 0; r < benchRuns; r++) {
+    cycles = std::min(cycles, synth_render_cycles(FM_BUDGET_VOICES, SYNTH_USES_INTERP, WAVEFORM_FM));
+  }
+  host_expect(cycles <= budget, "synth FM bench: " + std::to_string(FM_BUDGET_VOICES) + " voices, " +
+    std::to_string(cycles) + " host cyc/smp, budget " + std::to_string(budget));
+}
+
+void check_render() {
+  static synth_obj bench;
+  const uint voiceCounts[] = {1, 8, 16};
+  for (auto v : voiceCounts) {
+    if (v > POLYPHONY_LIMIT) {
+      printf("synth bench: %u voices is above POLYPHONY_LIMIT, skipped\n", v);
+      continue;
+    }
+    float next = best_cycles([&] {
+      bench_synth(bench, v);
+      uint32_t sum = 0;
+      for (uint s = 0; s < benchSamples; s++) {
+        sum += bench.next_sample();
+      }
+      benchKeep = sum;
+    });
+    float render = best_cycles([&] {
+      bench_synth(bench, v);
+      audio_sample out[SYNTH_BLOCK_SIZE];
+      uint32_t sum = 0;
+      for (uint s = 0; s < benchSamples; s += SYNTH_BLOCK_SIZE) {
+        bench.render(out, SYNTH_BLOCK_SIZE);
+        sum += out[0];
+      }
+      benchKeep = sum;
+    });
+    str line = "synth bench: " + std::to_string(v) + " voices, next_sample " + std::to_string(next) +
+      " host cyc/smp, render " + std::to_string(render) + " (" + std::to_string(render / v) + " per voice)";
+    if (v > 1) {
+      host_expect(render < next, line);
+    } else {
+      puts(line.c_str());
+    }
+  }
+}
+
+int main() {
+  hardware_setup();
+  synth_setup();
+  check_render();
+  check_filters();
+  check_fm();
+  return hostFailures;
+}
@@ -0,0 +1,186 @@
+/*
+  Offline render of the synth, on a computer. A copy of the synth
+  plays a short script of notes and wheel moves, with its own
+  wheels, and the result is written as a 16-bit WAV file so it
+  can be listened to or compared with an earlier build. The
+  render cost, peak and RMS level are printed. Then each waveform
+  plays one note, tuned to fall exactly on a bin, and the level
+  of its first harmonics and of everything else (aliasing and
+  noise) is printed, in dB from the fundamental.
+    make render               writes render.wav
+    ./synth_render out.wav    writes out.wav
+*/
+#include "host.h"
+
+enum {
+  RENDER_NOTE_ON,   // value = MIDI note
+  RENDER_NOTE_OFF,
+  RENDER_BEND,      // value = pitch bend wheel
+  RENDER_MOD,       // value = mod wheel
+  RENDER_END
+};
+struct render_event_t {
+  uint     at_mS;
+  uint8_t  what;
+  uint8_t  voice;
+  int16_t  value;
+};
+const render_event_t synthRenderScript[] = {
+  {    0, RENDER_NOTE_ON,  0, 60},
+  {  250, RENDER_NOTE_ON,  1, 64},
+  {  500, RENDER_NOTE_ON,  2, 67},
+  { 1000, RENDER_BEND,     0, 8191},
+  { 1250, RENDER_BEND,     0, -8192},
+  { 1500, RENDER_BEND,     0, 0},
+  { 1750, RENDER_MOD,      0, 127},
+  { 2500, RENDER_MOD,      0, 0},
+  { 2750, RENDER_NOTE_OFF, 0, 0},
+  { 2750, RENDER_NOTE_OFF, 1, 0},
+  { 2750, RENDER_NOTE_OFF, 2, 0},
+  { 3500, RENDER_END,      0, 0}
+};
+void write_le(FILE* f, uint32_t value, uint bytes) {
+  for (uint b = 0; b < bytes; b++) {
+    fputc((uint8_t)(value >> (8 * b)), f);
+  }
+}
+void write_wav_header(FILE* f, uint samples) {
+  uint rate = audioOut.get_sample_rate();
+  fwrite("RIFF", 1, 4, f);
+  write_le(f, 36 + 2 * samples, 4);
+  fwrite("WAVEfmt ", 1, 8, f);
+  write_le(f, 16, 4);         // format chunk size
+  write_le(f, 1, 2);          // PCM
+  write_le(f, 1, 2);          // mono
+  write_le(f, rate, 4);
+  write_le(f, 2 * rate, 4);   // bytes per second
+  write_le(f, 2, 2);          // bytes per sample
+  write_le(f, 16, 2);         // bits per sample
+  fwrite("data", 1, 4, f);
+  write_le(f, 2 * samples, 4);
+}
+bool synth_render_script(const char* path) {
+  synth_obj test;
+  bench_synth(test, 0);
+  int16_t bend = 0;
+  int16_t mod = 0;
+  test.bendWheel = &bend;
+  test.modulation = &mod;
+  uint rate = audioOut.get_sample_rate();
+  uint total = (uint64_t)synthRenderScript[sizeof(synthRenderScript) / sizeof(render_event_t) - 1].at_mS * rate / 1000;
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    printf("could not write %s\n", path);
+    return false;
+  }
+  write_wav_header(f, total);
+  uint32_t cycles = 0;
+  uint peak = 0;
+  uint64_t sumSquares = 0;
+  uint done = 0;
+  for (auto& e : synthRenderScript) {
+    uint until = (uint64_t)e.at_mS * rate / 1000;
+    while (done < until) {
+      audio_sample out[SYNTH_BLOCK_SIZE];
+      uint n = std::min(until - done, (uint)SYNTH_BLOCK_SIZE);
+      uint32_t start = rp2040.getCycleCount();
+      test.render(out, n);
+      cycles += rp2040.getCycleCount() - start;
+      int16_t pcm[SYNTH_BLOCK_SIZE];
+      for (uint s = 0; s < n; s++) {
+        pcm[s] = (int32_t)out[s] - 32768;
+        peak = std::max(peak, (uint)abs(pcm[s]));
+        sumSquares += (int32_t)pcm[s] * pcm[s];
+      }
+      fwrite(pcm, 2, n, f);   // the host is little-endian, like the WAV
+      done += n;
+    }
+    switch (e.what) {
+      case RENDER_NOTE_ON:  test.note_on(MIDItoFreq(e.value), e.voice + 1); break;
+      case RENDER_NOTE_OFF: test.note_off(e.voice + 1);                    break;
+      case RENDER_BEND:     bend = e.value;                                break;
+      case RENDER_MOD:      mod = e.value;                                 break;
+      default:
+        break;
+    }
+  }
+  fclose(f);
+  float rms = sqrt((float)sumSquares / std::max(total, 1u));
+  printf(
+    "synth render: %u samples to %s, %u host cyc/smp, peak %.1f dBFS, RMS %.1f dBFS\n",
+    total, path, cycles / std::max(total, 1u),
+    20 * log10f(std::max(peak, 1u) / 32768.0f), 20 * log10f(std::max(rms, 1.0f) / 32768.0f)
+  );
+  return true;
+}
+// power of one DFT bin, by Goertzel
+float bin_power(const int16_t* x, uint n, uint bin) {
+  float c = 2 * cosf(2 * PI * bin / n);
+  float s1 = 0;
+  float s2 = 0;
+  for (uint i = 0; i < n; i++) {
+    float s0 = x[i] + c * s1 - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+  return s1 * s1 + s2 * s2 - c * s1 * s2;
+}
+void synth_render_spectra() {
+  const uint8_t waves[] = {WAVEFORM_SINE, WAVEFORM_STRINGS, WAVEFORM_CLARINET, WAVEFORM_USER,
+                           WAVEFORM_HYBRID, WAVEFORM_SQUARE, WAVEFORM_SAW, WAVEFORM_TRIANGLE, WAVEFORM_FM};
+  const uint n = 1024;
+  const uint fundamentalBin = 29;    // about 885 Hz at 31250 Hz
+  const uint harmonicsShown = 8;
+  int16_t x[n];
+  for (auto w : waves) {
+    synth_obj test;
+    bench_synth(test, 0);
+    int16_t still = 0;
+    test.bendWheel = &still;
+    test.modulation = &still;
+    test.note_on((float)fundamentalBin * audioOut.get_sample_rate() / n, 1);
+    audio_sample out[SYNTH_BLOCK_SIZE];
+    for (uint s = 0; s < audioOut.get_sample_rate() / 2; s += SYNTH_BLOCK_SIZE) {
+      test.render(out, SYNTH_BLOCK_SIZE, w);    // past the attack and decay
+    }
+    for (uint s = 0; s < n; s += SYNTH_BLOCK_SIZE) {
+      test.render(out, SYNTH_BLOCK_SIZE, w);
+      for (uint i = 0; i < SYNTH_BLOCK_SIZE; i++) {
+        x[s + i] = (int32_t)out[i] - 32768;
+      }
+    }
+    float mean = 0;
+    for (uint i = 0; i < n; i++) {
+      mean += x[i];
+    }
+    mean /= n;
+    float total = 0;
+    for (uint i = 0; i < n; i++) {
+      total += (x[i] - mean) * (x[i] - mean);
+    }
+    total *= n / 2;   // Parseval, in the same units as bin_power
+    float fundamental = std::max(bin_power(x, n, fundamentalBin), 1.0f);
+    float harmonics = 0;
+    str line = "synth spectrum: wave " + std::to_string(w) + ", harmonics dB";
+    for (uint h = 1; h * fundamentalBin < n / 2; h++) {
+      float p = bin_power(x, n, h * fundamentalBin);
+      harmonics += p;
+      if (h <= harmonicsShown) {
+        line += " " + std::to_string((int)round(10 * log10f(std::max(p, 1.0f) / fundamental)));
+      }
+    }
+    float rest = std::max(total - harmonics, 1.0f);
+    line += ", rest " + std::to_string((int)round(10 * log10f(rest / fundamental))) + " dB";
+    puts(line.c_str());
+  }
+}
+
+int main(int argc, char** argv) {
+  hardware_setup();
+  synth_setup();
+  if (!synth_render_script(argc > 1 ? argv[1] : "render.wav")) {
+    return 1;
+  }
+  synth_render_spectra();
+  return 0;
+}
@@ -0,0 +1,107 @@
+/*
+  The oscillator's pitch. Every pitch of every tuning in the MIDI
+  range (0..127) is set on an oscillator, and the frequency its
+  32-bit increment plays at the real sample rate must be within
+  a cent. Then a few low notes of 72 equal, where a short phase
+  accumulator was worst, are rendered and timed from their zero
+  crossings. Last, the wavetables must join up at the wrap, so
+  the linear interpolation past the last entry reads the first.
+*/
+#include "host.h"
+
+void check_increments() {
+  oscillator o;
+  uint rate = audioOut.get_sample_rate();
+  float worst = 0;
+  str worstName;
+  for (uint T = 0; T < TUNINGCOUNT; T++) {
+    float stepSize = tuningOptions[T].stepSize;
+    float base = freqToMIDI(CONCERT_A_HZ);
+    for (int steps = -ceil(base * 100 / stepSize); steps * stepSize / 100 + base < 128; steps++) {
+      float N = base + steps * stepSize / 100;
+      if (N < 0) {
+        continue;
+      }
+      float f = MIDItoFreq(N);
+      o.set_frequency(f);
+      float played = o.increment * (double)rate / 4294967296.0;
+      float error = fabsf(1200 * log2f(played / f));
+      if (error > worst) {
+        worst = error;
+        worstName = tuningOptions[T].name;
+      }
+    }
+  }
+  host_expect(worst < 1, "synth tuning: worst error " + std::to_string(worst) + " cents, in " + worstName);
+}
+
+// the frequency of a rendered sine, from its first and last rising zero crossings
+float measured_frequency(float f, uint seconds) {
+  synth_obj test;
+  bench_synth(test, 0);
+  int16_t still = 0;
+  test.bendWheel = &still;
+  test.modulation = &still;
+  test.note_on(f, 1);
+  uint rate = audioOut.get_sample_rate();
+  audio_sample out[SYNTH_BLOCK_SIZE];
+  for (uint s = 0; s < rate / 2; s += SYNTH_BLOCK_SIZE) {
+    test.render(out, SYNTH_BLOCK_SIZE, WAVEFORM_SINE);    // past the attack and decay
+  }
+  float first = -1;
+  float last = 0;
+  uint crossings = 0;
+  int32_t prev = 0;
+  for (uint s = 0; s < seconds * rate; s += SYNTH_BLOCK_SIZE) {
+    test.render(out, SYNTH_BLOCK_SIZE, WAVEFORM_SINE);
+    for (uint i = 0; i < SYNTH_BLOCK_SIZE; i++) {
+      int32_t x = (int32_t)out[i] - 32768;
+      if ((s + i > 0) && (prev < 0) && (x >= 0)) {
+        float at = s + i - 1 + (float)-prev / (x - prev);
+        if (first < 0) {
+          first = at;
+        } else {
+          last = at;
+          ++crossings;
+        }
+      }
+      prev = x;
+    }
+  }
+  return crossings * rate / (last - first);
+}
+void check_rendered() {
+  float worst = 0;
+  for (uint step = 0; step <= 144; step += 7) {
+    float f = 27.5 * exp2f(step / 72.0);    // A0 to A2 in 72 equal
+    worst = std::max(worst, fabsf(1200 * log2f(measured_frequency(f, 4) / f)));
+  }
+  host_expect(worst < 1, "synth tuning: rendered low notes of 72 equal, worst error " + std::to_string(worst) + " cents");
+}
+
+void check_tables() {
+  bool joined = (sineTable[256] == sineTable[0]);
+  for (auto t : {&stringsTable, &clarinetTable, &userTable}) {
+    for (auto& level : t->level) {
+      joined = joined && (level[256] == level[0]);
+    }
+  }
+  host_expect(joined, "wavetables: the guard entry repeats the first");
+  bool between = true;
+  for (uint t = 0; t < 256; t++) {
+    int a = sineTable[t];
+    int b = sineTable[t + 1];
+    int mid = table_lookup(sineTable, (t << 24) | (1u << 23));
+    between = between && (mid >= std::min(a, b)) && (mid <= std::max(a, b)) && (abs(2 * mid - a - b) <= 1);
+  }
+  host_expect(between, "wavetables: half way between two entries reads half way between their levels");
+}
+
+int main() {
+  hardware_setup();
+  synth_setup();
+  check_increments();
+  check_rendered();
+  check_tables();
+  return hostFailures;
+}